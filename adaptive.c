@@ -0,0 +1,66 @@
+#include "huff.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+AdaptiveModel* createAdaptiveModel(int lengthLimit)
+{
+	// Every character starts with a count of one so it always has a code, Pseudo-EOF is never coded
+	AdaptiveModel* model = malloc(sizeof(*model));
+	int i;
+	for(i = 0; i < ASCII_COUNT; i++)
+	{
+		model -> frequencies[i] = 1;
+	}
+	model -> frequencies[PSEUDO_EOF_VALUE] = 0;
+	model -> arena = createArena(ARENA_BLOCK_SIZE);
+	model -> table = NULL;
+	model -> lengthLimit = lengthLimit;
+	model -> seen = 0;
+	model -> interval = ADAPTIVE_FIRST_INTERVAL;
+	rebuildAdaptiveCodes(model);
+
+	return model;
+}
+
+void rebuildAdaptiveCodes(AdaptiveModel* model)
+{
+	// Codes from the counts so far, the previous tree and table are no longer needed
+	resetArena(model -> arena);
+	model -> table = NULL;
+	buildCanonicalCodes(model -> arena, model -> frequencies, model -> lengthLimit, model -> codes);
+
+	// Rebuild often while the counts are few, less often as they settle
+	model -> nextRebuild = model -> seen + model -> interval;
+	if(model -> interval < ADAPTIVE_MAX_INTERVAL)
+	{
+		model -> interval *= 2;
+	}
+}
+
+void encodeAdaptive(AdaptiveModel* model, BitWriter* writer, const unsigned char* data, size_t size)
+{
+	size_t i = 0;
+	while(i < size)
+	{
+		if(model -> seen == model -> nextRebuild)
+		{
+			rebuildAdaptiveCodes(model);
+		}
+
+		// Code every character up to the next rebuild with the current codes
+		size_t end = size - i < model -> nextRebuild - model -> seen ? size : i + (model -> nextRebuild - model -> seen);
+		model -> seen += end - i;
+		for(; i < end; i++)
+		{
+			writeBits(writer, model -> codes[data[i]].bits, model -> codes[data[i]].length);
+			model -> frequencies[data[i]]++;
+		}
+	}
+}
+
+void freeAdaptiveModel(AdaptiveModel* model)
+{
+	freeArena(model -> arena);
+	free(model);
+}
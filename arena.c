@@ -0,0 +1,143 @@
+#include "huff.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+Arena* createArena(size_t blockSize)
+{
+	// Initialize arena with one block ready for use
+	Arena* arena = malloc(sizeof(*arena));
+	arena -> blockSize = blockSize;
+	arena -> blocks = NULL;
+	arena -> last = NULL;
+	arena -> allocationCount = 0;
+	arena -> bytesAllocated = 0;
+	arena -> systemAllocations = 0;
+	addArenaBlock(arena, blockSize);
+
+	return arena;
+}
+
+void* arenaAlloc(Arena* arena, size_t size)
+{
+	// Keep every allocation aligned for any type
+	size = (size + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+
+	// If the current block is full, start a new one big enough for the request
+	ArenaBlock* block = arena -> blocks;
+	if(block -> used + size > block -> size)
+	{
+		block = addArenaBlock(arena, size > arena -> blockSize ? size : arena -> blockSize);
+	}
+
+	void* memory = block -> memory + block -> used;
+	block -> used += size;
+	arena -> last = memory;
+	arena -> allocationCount++;
+	arena -> bytesAllocated += size;
+	return memory;
+}
+
+void* arenaGrow(Arena* arena, void* memory, size_t oldSize, size_t newSize)
+{
+	oldSize = (oldSize + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+	newSize = (newSize + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+
+	// If it was the last allocation and there is room behind it, extend it in place
+	ArenaBlock* block = arena -> blocks;
+	if(memory == arena -> last && block -> used - oldSize + newSize <= block -> size)
+	{
+		block -> used += newSize - oldSize;
+		arena -> bytesAllocated += newSize - oldSize;
+		return memory;
+	}
+
+	// Otherwise copy it to a new allocation
+	void* grown = arenaAlloc(arena, newSize);
+	memcpy(grown, memory, oldSize);
+	return grown;
+}
+
+void resetArena(Arena* arena)
+{
+	// Keep one block that holds everything this use needed, so arenas reset for every block stop going
+	// back to the system, but no more than the limit, so one large file does not hold on to its memory
+	// for every file after it. The largest block within the limit is kept if it is big enough
+	size_t used = 0;
+	ArenaBlock* kept = NULL;
+	ArenaBlock* block;
+	for(block = arena -> blocks; block != NULL; block = block -> next)
+	{
+		used += block -> used;
+		if(block -> size <= ARENA_RETAIN_LIMIT && (kept == NULL || block -> size > kept -> size))
+		{
+			kept = block;
+		}
+	}
+	size_t wanted = used < ARENA_RETAIN_LIMIT ? used : ARENA_RETAIN_LIMIT;
+	if(kept != NULL && kept -> size < wanted)
+	{
+		kept = NULL;
+	}
+
+	// Free every other block, then start a single one of the size wanted if none was kept
+	block = arena -> blocks;
+	while(block != NULL)
+	{
+		ArenaBlock* next = block -> next;
+		if(block != kept)
+		{
+			free(block);
+		}
+		block = next;
+	}
+	arena -> blocks = kept;
+	if(kept != NULL)
+	{
+		kept -> next = NULL;
+	}
+	else
+	{
+		addArenaBlock(arena, wanted > arena -> blockSize ? wanted : arena -> blockSize);
+	}
+
+	// Hand out the same memory again, counting from zero
+	arena -> blocks -> used = 0;
+	arena -> last = NULL;
+	arena -> allocationCount = 0;
+	arena -> bytesAllocated = 0;
+	arena -> systemAllocations = 0;
+}
+
+ArenaBlock* addArenaBlock(Arena* arena, size_t size)
+{
+	// Block header and its memory come from one system allocation
+	ArenaBlock* block = malloc(sizeof(*block) + size);
+	block -> next = arena -> blocks;
+	block -> size = size;
+	block -> used = 0;
+	block -> memory = (unsigned char*)(block + 1);
+	arena -> blocks = block;
+	arena -> systemAllocations++;
+
+	return block;
+}
+
+void printArenaUsage(Arena* arena, char* filename)
+{
+	printf("%s: %lu allocations, %lu bytes, %lu system allocations\n", filename,
+		arena -> allocationCount, arena -> bytesAllocated, arena -> systemAllocations);
+}
+
+void freeArena(Arena* arena)
+{
+	// Free every block, then the arena itself
+	ArenaBlock* block = arena -> blocks;
+	while(block != NULL)
+	{
+		ArenaBlock* next = block -> next;
+		free(block);
+		block = next;
+	}
+	free(arena);
+}
@@ -0,0 +1,248 @@
+#include "huff.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+char** collectFiles(Arena* arena, char** arguments, int argumentCount, char* listFilename, char* outputDirectory, int* fileCount)
+{
+	int capacity = argumentCount + 16;
+	char** files = arenaAlloc(arena, sizeof(*files) * capacity);
+	*fileCount = 0;
+	int i;
+	for(i = 0; i < argumentCount; i++)
+	{
+		// Directories are replaced by the regular files anywhere below them
+		struct stat status;
+		if(stat(arguments[i], &status) == 0 && S_ISDIR(status.st_mode))
+		{
+			files = addDirectory(arena, files, fileCount, &capacity, arguments[i]);
+		}
+		else
+		{
+			files = addFile(arena, files, fileCount, &capacity, arguments[i]);
+		}
+	}
+
+	// A list holds one filename per line
+	if(listFilename != NULL)
+	{
+		FILE* list = fopen(listFilename, "r");
+		if(list == NULL)
+		{
+			fprintf(stderr, "Cannot open %s\n", listFilename);
+			return NULL;
+		}
+		char line[4096];
+		while(fgets(line, sizeof(line), list) != NULL)
+		{
+			line[strcspn(line, "\r\n")] = '\0';
+			if(line[0] == '\0')
+			{
+				continue;
+			}
+			char* path = arenaAlloc(arena, strlen(line) + 1);
+			strcpy(path, line);
+			files = addFile(arena, files, fileCount, &capacity, path);
+		}
+		fclose(list);
+	}
+
+	// Outputs keep the path of their file, so its directories must exist under the output directory
+	for(i = 0; i < *fileCount; i++)
+	{
+		createOutputDirectories(arena, outputDirectory, files[i]);
+	}
+	return files;
+}
+
+bool runBatch(char** files, int fileCount, int jobCount, bool (*process)(Arena*, char*, void*), void* options)
+{
+	// Every slot holds one file being processed, with room for two per worker, and keeps its arena between files
+	int slotCount = jobCount * 2;
+	FileJob* jobs = malloc(sizeof(*jobs) * slotCount);
+	int i;
+	for(i = 0; i < slotCount; i++)
+	{
+		jobs[i].arena = createArena(ARENA_BLOCK_SIZE);
+		jobs[i].process = process;
+		jobs[i].options = options;
+	}
+	double* latencies = malloc(sizeof(*latencies) * (fileCount > 0 ? fileCount : 1));
+	ThreadPool* pool = createThreadPool(jobCount);
+	struct timespec start;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	// Fill every slot, then collect files in order, refilling each slot as its file is collected
+	int file;
+	for(file = 0; file < fileCount && file < slotCount; file++)
+	{
+		submitFile(pool, &jobs[file], files[file]);
+	}
+	bool success = true;
+	uint64_t totalSize = 0;
+	for(file = 0; file < fileCount; file++)
+	{
+		FileJob* job = &jobs[file % slotCount];
+		waitForTask(pool, &job -> done);
+		success = job -> success && success;
+		totalSize += job -> size;
+		latencies[file] = job -> seconds;
+
+		if(file + slotCount < fileCount)
+		{
+			submitFile(pool, job, files[file + slotCount]);
+		}
+	}
+
+	struct timespec end;
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+	printBatchReport(latencies, fileCount, totalSize, seconds);
+
+	freeThreadPool(pool);
+	for(i = 0; i < slotCount; i++)
+	{
+		freeArena(jobs[i].arena);
+	}
+	free(latencies);
+	free(jobs);
+	return success;
+}
+
+void submitFile(ThreadPool* pool, FileJob* job, char* filename)
+{
+	job -> filename = filename;
+	resetArena(job -> arena);
+	submitTask(pool, processFile, job, &job -> done);
+}
+
+void processFile(void* argument)
+{
+	FileJob* job = argument;
+
+	// Latency covers everything done for the file, from opening it to closing its output
+	struct timespec start;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	struct stat status;
+	job -> size = stat(job -> filename, &status) == 0 ? status.st_size : 0;
+	job -> success = job -> process(job -> arena, job -> filename, job -> options);
+	struct timespec end;
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	job -> seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+}
+
+char** addFile(Arena* arena, char** files, int* fileCount, int* capacity, char* filename)
+{
+	if(*fileCount == *capacity)
+	{
+		files = arenaGrow(arena, files, sizeof(*files) * *capacity, sizeof(*files) * *capacity * 2);
+		*capacity *= 2;
+	}
+	files[(*fileCount)++] = filename;
+	return files;
+}
+
+char** addDirectory(Arena* arena, char** files, int* fileCount, int* capacity, char* directoryName)
+{
+	DIR* directory = opendir(directoryName);
+	if(directory == NULL)
+	{
+		fprintf(stderr, "Cannot open %s\n", directoryName);
+		return files;
+	}
+
+	struct dirent* entry;
+	while((entry = readdir(directory)) != NULL)
+	{
+		if(strcmp(entry -> d_name, ".") == 0 || strcmp(entry -> d_name, "..") == 0)
+		{
+			continue;
+		}
+		char* path = arenaAlloc(arena, strlen(directoryName) + strlen(entry -> d_name) + 2);
+		strcpy(path, directoryName);
+		strcat(path, "/");
+		strcat(path, entry -> d_name);
+
+		// Links to directories are not followed, so a link back up the tree cannot loop
+		struct stat status;
+		if(lstat(path, &status) == 0 && S_ISDIR(status.st_mode))
+		{
+			files = addDirectory(arena, files, fileCount, capacity, path);
+		}
+		else if(stat(path, &status) == 0 && S_ISREG(status.st_mode))
+		{
+			files = addFile(arena, files, fileCount, capacity, path);
+		}
+	}
+	closedir(directory);
+	return files;
+}
+
+char* getOutputPath(Arena* arena, char* outputDirectory, char* filename, char* extension)
+{
+	char* path = arenaAlloc(arena, strlen(outputDirectory) + strlen(filename) + strlen(extension) + 1);
+	strcpy(path, outputDirectory);
+
+	// Empty, '.' and '..' components are dropped, so every output lands inside the output directory
+	char* end = path + strlen(path);
+	char* component = filename;
+	while(*component != '\0')
+	{
+		size_t length = strcspn(component, "/");
+		bool skipped = length == 0 || (length == 1 && component[0] == '.') || (length == 2 && strncmp(component, "..", 2) == 0);
+		if(!skipped)
+		{
+			if(end != path + strlen(outputDirectory))
+			{
+				*end++ = '/';
+			}
+			memcpy(end, component, length);
+			end += length;
+		}
+		component += length + (component[length] == '/');
+	}
+	strcpy(end, extension);
+	return path;
+}
+
+void createOutputDirectories(Arena* arena, char* outputDirectory, char* filename)
+{
+	char* path = getOutputPath(arena, outputDirectory, filename, "");
+
+	// Create every directory along the path, stopping short of the file itself
+	char* separator;
+	for(separator = strchr(path + strlen(outputDirectory), '/'); separator != NULL; separator = strchr(separator + 1, '/'))
+	{
+		*separator = '\0';
+		if(mkdir(path, 0777) != 0 && errno != EEXIST)
+		{
+			fprintf(stderr, "Cannot create %s\n", path);
+		}
+		*separator = '/';
+	}
+}
+
+void printBatchReport(double* latencies, int fileCount, uint64_t totalSize, double seconds)
+{
+	// Percentiles are read by rank from the sorted latencies
+	qsort(latencies, fileCount, sizeof(*latencies), compareLatencies);
+	fprintf(stderr, "%d files, %.1f MiB in %.3f s, %.1f MiB/s\n", fileCount, totalSize / 1048576.0, seconds,
+		seconds > 0 ? totalSize / 1048576.0 / seconds : 0);
+	if(fileCount > 0)
+	{
+		fprintf(stderr, "Latency ms: p50 %.3f, p90 %.3f, p99 %.3f, max %.3f\n",
+			latencies[(fileCount - 1) * 50 / 100] * 1e3, latencies[(fileCount - 1) * 90 / 100] * 1e3,
+			latencies[(fileCount - 1) * 99 / 100] * 1e3, latencies[fileCount - 1] * 1e3);
+	}
+}
+
+int compareLatencies(const void* x, const void* y)
+{
+	double first = *(const double*)x;
+	double second = *(const double*)y;
+	return (first > second) - (first < second);
+}
@@ -0,0 +1,14 @@
+#ifndef __bench_h_
+#define __bench_h_
+
+#include <time.h>
+
+// Returns a monotonic time in seconds, for timing benchmark runs
+static inline double getSeconds()
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+#endif
@@ -0,0 +1,89 @@
+#include "../huff.h"
+#include "bench.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Message sizes compared, from small records to large chunks
+static const size_t MESSAGE_SIZES[] = {64, 256, 1024, 4096, 16384, 65536};
+
+// Most of each file that is split into messages
+#define BENCH_INPUT_LIMIT (4 << 20)
+
+int main(int argc, char* argv[])
+{
+	if(argc == 1)
+	{
+		printf("Usage: bench_adaptive file...\n");
+		return EXIT_FAILURE;
+	}
+
+	printf("%-24s %8s %10s %10s %12s %10s %12s\n", "file", "message", "bytes", "static", "us/message", "adaptive", "us/message");
+	Arena* arena = createArena(ARENA_BLOCK_SIZE);
+	int i;
+	for(i = 1; i < argc; i++)
+	{
+		FILE* fp = fopen(argv[i], "rb");
+		if(fp == NULL)
+		{
+			printf("Cannot open %s\n", argv[i]);
+			continue;
+		}
+		unsigned char* data = malloc(BENCH_INPUT_LIMIT);
+		size_t size = fread(data, 1, BENCH_INPUT_LIMIT, fp);
+		fclose(fp);
+		const char* name = strrchr(argv[i], '/') != NULL ? strrchr(argv[i], '/') + 1 : argv[i];
+
+		size_t s;
+		for(s = 0; s < sizeof(MESSAGE_SIZES) / sizeof(*MESSAGE_SIZES); s++)
+		{
+			size_t messageSize = MESSAGE_SIZES[s];
+			size_t messageCount = (size + messageSize - 1) / messageSize;
+
+			// Static: every message is counted and gets its own code length header, like a stream block
+			unsigned long staticBytes = 0;
+			double start = getSeconds();
+			size_t offset;
+			for(offset = 0; offset < size; offset += messageSize)
+			{
+				size_t length = size - offset < messageSize ? size - offset : messageSize;
+				resetArena(arena);
+				unsigned long frequencies[ASCII_COUNT] = {0};
+				countBytes(data + offset, length, frequencies);
+				frequencies[PSEUDO_EOF_VALUE] = PSEUDO_EOF_FREQUENCY;
+				Code codeTable[ASCII_COUNT];
+				buildCanonicalCodes(arena, frequencies, DEFAULT_CODE_LENGTH_LIMIT, codeTable);
+				BitWriter* writer = createMemoryBitWriter(arena, getCompressedBound(length, DEFAULT_CODE_LENGTH_LIMIT));
+				writeCodeLengths(writer, codeTable);
+				encodeData(writer, codeTable, data + offset, length);
+				writeBits(writer, codeTable[PSEUDO_EOF_VALUE].bits, codeTable[PSEUDO_EOF_VALUE].length);
+				flushBitWriter(writer);
+				staticBytes += writer -> position + BLOCK_INDEX_ENTRY_SIZE;
+			}
+			double staticTime = getSeconds() - start;
+
+			// Adaptive: one model carried across messages, no header
+			resetArena(arena);
+			BitWriter* writer = createMemoryBitWriter(arena, getCompressedBound(messageSize, DEFAULT_CODE_LENGTH_LIMIT));
+			AdaptiveModel* model = createAdaptiveModel(DEFAULT_CODE_LENGTH_LIMIT);
+			unsigned long adaptiveBytes = 0;
+			start = getSeconds();
+			for(offset = 0; offset < size; offset += messageSize)
+			{
+				size_t length = size - offset < messageSize ? size - offset : messageSize;
+				encodeAdaptive(model, writer, data + offset, length);
+				flushBitWriter(writer);
+				adaptiveBytes += writer -> position + BLOCK_INDEX_ENTRY_SIZE;
+				writer -> position = 0;
+			}
+			double adaptiveTime = getSeconds() - start;
+			freeAdaptiveModel(model);
+
+			printf("%-24s %8zu %10zu %10lu %12.2f %10lu %12.2f\n", name, messageSize, size,
+				staticBytes, staticTime * 1e6 / messageCount, adaptiveBytes, adaptiveTime * 1e6 / messageCount);
+		}
+		free(data);
+	}
+	freeArena(arena);
+	return EXIT_SUCCESS;
+}
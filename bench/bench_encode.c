@@ -0,0 +1,83 @@
+#include "../huff.h"
+#include "bench.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Most of each file that is coded
+#define BENCH_INPUT_LIMIT (32 << 20)
+
+// Least time every encoder is run for on a file, the fastest run is reported
+#define BENCH_MIN_SECONDS 0.2
+
+int main(int argc, char* argv[])
+{
+	if(argc == 1)
+	{
+		printf("Usage: bench_encode file...\n");
+		return EXIT_FAILURE;
+	}
+
+	printf("%-24s %10s %8s %12s %12s %8s\n", "file", "bytes", "longest", "scalar MB/s", "bulk MB/s", "speedup");
+	Arena* arena = createArena(ARENA_BLOCK_SIZE);
+	int i;
+	for(i = 1; i < argc; i++)
+	{
+		FILE* fp = fopen(argv[i], "rb");
+		if(fp == NULL)
+		{
+			printf("Cannot open %s\n", argv[i]);
+			continue;
+		}
+		unsigned char* data = malloc(BENCH_INPUT_LIMIT);
+		size_t size = fread(data, 1, BENCH_INPUT_LIMIT, fp);
+		fclose(fp);
+		const char* name = strrchr(argv[i], '/') != NULL ? strrchr(argv[i], '/') + 1 : argv[i];
+
+		resetArena(arena);
+		unsigned long frequencies[ASCII_COUNT] = {0};
+		countBytes(data, size, frequencies);
+		frequencies[PSEUDO_EOF_VALUE] = PSEUDO_EOF_FREQUENCY;
+		Code codeTable[ASCII_COUNT];
+		buildCanonicalCodes(arena, frequencies, DEFAULT_CODE_LENGTH_LIMIT, codeTable);
+
+		// Both encoders write into memory writers of the same size, which must end up byte for byte equal
+		size_t bound = getCompressedBound(size, DEFAULT_CODE_LENGTH_LIMIT);
+		BitWriter* writers[2];
+		double best[2] = {1e9, 1e9};
+		int kind;
+		for(kind = 0; kind < 2; kind++)
+		{
+			writers[kind] = createMemoryBitWriter(arena, bound);
+			double total = 0;
+			while(total < BENCH_MIN_SECONDS)
+			{
+				BitWriter* writer = writers[kind];
+				writer -> position = 0;
+				writer -> bits = 0;
+				writer -> count = 0;
+				double start = getSeconds();
+				if(kind == 0)
+				{
+					encodeDataScalar(writer, codeTable, data, size);
+				}
+				else
+				{
+					encodeDataBulk(writer, codeTable, data, size);
+				}
+				flushBitWriter(writer);
+				double seconds = getSeconds() - start;
+				best[kind] = seconds < best[kind] ? seconds : best[kind];
+				total += seconds + 1e-6;
+			}
+		}
+		bool valid = writers[0] -> position == writers[1] -> position &&
+			memcmp(writers[0] -> buffer, writers[1] -> buffer, writers[0] -> position) == 0;
+
+		printf("%-24s %10zu %8d %12.1f %12.1f %7.2fx%s\n", name, size, getMaxCodeLength(codeTable), size / best[0] / 1e6,
+			size / best[1] / 1e6, best[0] / best[1], valid ? "" : " MISMATCH");
+		free(data);
+	}
+	freeArena(arena);
+	return EXIT_SUCCESS;
+}
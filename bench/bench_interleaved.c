@@ -0,0 +1,117 @@
+#include "../huff.h"
+#include "bench.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Most of each file that is coded
+#define BENCH_INPUT_LIMIT (32 << 20)
+
+// Times every decoder runs, the fastest run is reported
+#define BENCH_RUNS 5
+
+int main(int argc, char* argv[])
+{
+	if(argc == 1)
+	{
+		printf("Usage: bench_interleaved file...\n");
+		return EXIT_FAILURE;
+	}
+
+	printf("%-24s %10s %12s %12s %12s\n", "file", "bytes", "single MB/s", "paired MB/s", "4-way MB/s");
+	Arena* arena = createArena(ARENA_BLOCK_SIZE);
+	int i;
+	for(i = 1; i < argc; i++)
+	{
+		FILE* fp = fopen(argv[i], "rb");
+		if(fp == NULL)
+		{
+			printf("Cannot open %s\n", argv[i]);
+			continue;
+		}
+		unsigned char* data = malloc(BENCH_INPUT_LIMIT);
+		size_t size = fread(data, 1, BENCH_INPUT_LIMIT, fp);
+		fclose(fp);
+		const char* name = strrchr(argv[i], '/') != NULL ? strrchr(argv[i], '/') + 1 : argv[i];
+
+		// One set of codes for both layouts
+		resetArena(arena);
+		unsigned long frequencies[ASCII_COUNT] = {0};
+		countBytes(data, size, frequencies);
+		frequencies[PSEUDO_EOF_VALUE] = PSEUDO_EOF_FREQUENCY;
+		Code codeTable[ASCII_COUNT];
+		buildCanonicalCodes(arena, frequencies, DEFAULT_CODE_LENGTH_LIMIT, codeTable);
+
+		// Single stream ending in Pseudo-EOF, like writeCompressed
+		BitWriter* single = createMemoryBitWriter(arena, getCompressedBound(size, DEFAULT_CODE_LENGTH_LIMIT));
+		encodeData(single, codeTable, data, size);
+		writeBits(single, codeTable[PSEUDO_EOF_VALUE].bits, codeTable[PSEUDO_EOF_VALUE].length);
+		flushBitWriter(single);
+
+		// Interleaved chunks, like writeInterleaved without the code length header
+		BitWriter* interleaved = createMemoryBitWriter(arena, getCompressedBound(size, DEFAULT_CODE_LENGTH_LIMIT) +
+			(size / INTERLEAVE_CHUNK_SIZE + 1) * (INTERLEAVE_HEADER_SIZE + 4 * INTERLEAVE_STREAMS));
+		BitWriter* streams[INTERLEAVE_STREAMS];
+		int stream;
+		for(stream = 0; stream < INTERLEAVE_STREAMS; stream++)
+		{
+			streams[stream] = createMemoryBitWriter(arena, getCompressedBound(INTERLEAVE_CHUNK_SIZE / INTERLEAVE_STREAMS, DEFAULT_CODE_LENGTH_LIMIT));
+		}
+		size_t offset;
+		for(offset = 0; offset < size; offset += INTERLEAVE_CHUNK_SIZE)
+		{
+			encodeInterleaved(interleaved, streams, codeTable, data + offset, size - offset < INTERLEAVE_CHUNK_SIZE ? size - offset : INTERLEAVE_CHUNK_SIZE);
+		}
+		flushBitWriter(interleaved);
+
+		DecodeTable* singleTable = createDecodeTable(arena, codeTable);
+		DecodeTable* pairedTable = buildDecodeTable(arena, codeTable);
+		unsigned char* output = malloc(size + 1);
+		double best[3] = {1e9, 1e9, 1e9};
+		bool valid = true;
+		int run;
+		for(run = 0; run < BENCH_RUNS; run++)
+		{
+			// Single stream, one character per lookup and then paired lookups
+			int kind;
+			for(kind = 0; kind < 2; kind++)
+			{
+				BitReader reader;
+				initMemoryBitReader(&reader, single -> buffer, single -> position);
+				size_t position = 0;
+				double start = getSeconds();
+				decodeIntoBuffer(&reader, kind == 0 ? singleTable : pairedTable, output, size, &position);
+				double seconds = getSeconds() - start;
+				best[kind] = seconds < best[kind] ? seconds : best[kind];
+				valid = valid && position == size && memcmp(output, data, size) == 0;
+			}
+
+			// Four streams per chunk
+			memset(output, 0, size);
+			double start = getSeconds();
+			const unsigned char* chunk = interleaved -> buffer;
+			for(offset = 0; offset < size; offset += INTERLEAVE_CHUNK_SIZE)
+			{
+				uint32_t streamSizes[INTERLEAVE_STREAMS];
+				size_t total = 0;
+				for(stream = 0; stream < INTERLEAVE_STREAMS; stream++)
+				{
+					streamSizes[stream] = readUint32(chunk + 4 + 4 * stream);
+					total += streamSizes[stream];
+				}
+				valid = decodeInterleaved(singleTable, chunk + INTERLEAVE_HEADER_SIZE, streamSizes, output + offset, readUint32(chunk)) && valid;
+				chunk += INTERLEAVE_HEADER_SIZE + total;
+			}
+			double seconds = getSeconds() - start;
+			best[2] = seconds < best[2] ? seconds : best[2];
+			valid = valid && memcmp(output, data, size) == 0;
+		}
+
+		printf("%-24s %10zu %12.1f %12.1f %12.1f%s\n", name, size, size / best[0] / 1e6, size / best[1] / 1e6,
+			size / best[2] / 1e6, valid ? "" : " MISMATCH");
+		free(output);
+		free(data);
+	}
+	freeArena(arena);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,61 @@
+#include "../huff.h"
+#include "bench.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Number of times the model is rebuilt for every file
+#define MODEL_ITERATIONS 100000
+
+int main(int argc, char* argv[])
+{
+	if(argc == 1)
+	{
+		printf("Usage: bench_model file...\n");
+		return EXIT_FAILURE;
+	}
+
+	printf("%-24s %10s %8s %14s\n", "file", "bytes", "symbols", "ns/model");
+	int i;
+	for(i = 1; i < argc; i++)
+	{
+		FILE* fp = fopen(argv[i], "rb");
+		if(fp == NULL)
+		{
+			printf("Cannot open %s\n", argv[i]);
+			continue;
+		}
+
+		// Count characters once, only the model is timed
+		unsigned long frequencies[ASCII_COUNT] = {0};
+		unsigned long size = 0;
+		int character;
+		while((character = fgetc(fp)) != EOF)
+		{
+			frequencies[character]++;
+			size++;
+		}
+		frequencies[PSEUDO_EOF_VALUE] = PSEUDO_EOF_FREQUENCY;
+		fclose(fp);
+
+		// Build tree and code table the way huff does for every file, reusing one arena
+		Arena* arena = createArena(ARENA_BLOCK_SIZE);
+		Code codeTable[ASCII_COUNT];
+		int symbols = 0;
+		double start = getSeconds();
+		int j;
+		for(j = 0; j < MODEL_ITERATIONS; j++)
+		{
+			resetArena(arena);
+			Tree* tree = createTree(arena, frequencies);
+			getBitEncodings(tree, codeTable);
+			symbols = (tree -> nodeCount + 1) / 2;
+		}
+		double elapsed = getSeconds() - start;
+		freeArena(arena);
+
+		const char* name = strrchr(argv[i], '/') != NULL ? strrchr(argv[i], '/') + 1 : argv[i];
+		printf("%-24s %10lu %8d %14.1f\n", name, size, symbols, elapsed * 1e9 / MODEL_ITERATIONS);
+	}
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,489 @@
+#include "../huff.h"
+#include "bench.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+
+// Least time every stage is repeated for, so small files are measured over many runs
+#define BENCH_MIN_SECONDS 0.05
+
+// Slowdown against the baseline, as a fraction, reported as a regression
+#define BENCH_REGRESSION_THRESHOLD 0.10
+
+// Most files one run and one baseline can hold
+#define BENCH_MAX_FILES 256
+
+// Output formats
+#define OUTPUT_TABLE 0
+#define OUTPUT_CSV 1
+#define OUTPUT_JSON 2
+
+// Stages of compressing and decompressing a file, timed separately
+#define STAGE_HISTOGRAM 0
+#define STAGE_TREE 1
+#define STAGE_CODES 2
+#define STAGE_HEADER 3
+#define STAGE_ENCODE 4
+#define STAGE_DECODE 5
+#define STAGE_COUNT 6
+
+static const char* STAGE_NAMES[STAGE_COUNT] = {"histogram", "tree", "codes", "header", "encode", "decode"};
+
+// Size classes, every file belongs to the first class whose limit is above its size
+static const char* CLASS_NAMES[] = {"tiny", "small", "medium", "large"};
+static const size_t CLASS_LIMITS[] = {4 << 10, 64 << 10, 1 << 20, (size_t)-1};
+#define CLASS_COUNT 4
+
+// Synthetic corpora, from no skew to almost a single character
+static const char* SYNTHETIC_NAMES[] = {"uniform", "zipf", "geometric"};
+#define SYNTHETIC_COUNT 3
+
+// Everything the stages of one file share, each stage reads what the stage before it produced
+typedef struct
+{
+	const unsigned char*	data; // File contents
+	size_t			size; // Number of bytes in file
+	unsigned long		frequencies[ASCII_COUNT]; // Counts from the histogram stage
+	Arena*			treeArena; // Memory for the tree, reset every run
+	Arena*			codeArena; // Memory for length limiting, reset every run
+	Arena*			decodeArena; // Memory for the decoding table and reader, reset every run
+	Tree*			tree; // Tree from the tree stage
+	Code			codes[ASCII_COUNT]; // Canonical codes from the codes stage
+	BitWriter*		writer; // Memory writer for header and data
+	size_t			headerSize; // Bytes written by the header stage
+	size_t			dataSize; // Bytes written by the encode stage
+	unsigned char*		output; // Decoded contents
+	size_t			outputSize; // Bytes written by the decode stage
+} BenchState;
+
+// Measurements of one file
+typedef struct
+{
+	char		name[128]; // File name without directories
+	size_t		size; // Number of bytes in file
+	size_t		compressedSize; // Bytes of header and data
+	double		seconds[STAGE_COUNT]; // Time of one run of every stage
+	long		peakMemory; // Peak resident set size in KiB after the file
+	bool		valid; // True if the file decoded to its contents
+} BenchResult;
+
+void runHistogram(BenchState* state)
+{
+	memset(state -> frequencies, 0, sizeof(state -> frequencies));
+	countBytes(state -> data, state -> size, state -> frequencies);
+	state -> frequencies[PSEUDO_EOF_VALUE] = PSEUDO_EOF_FREQUENCY;
+}
+
+void runTree(BenchState* state)
+{
+	resetArena(state -> treeArena);
+	state -> tree = createTree(state -> treeArena, state -> frequencies);
+}
+
+void runCodes(BenchState* state)
+{
+	resetArena(state -> codeArena);
+	getBitEncodings(state -> tree, state -> codes);
+	if(getMaxCodeLength(state -> codes) > DEFAULT_CODE_LENGTH_LIMIT)
+	{
+		limitCodeLengths(state -> codeArena, state -> frequencies, state -> codes, DEFAULT_CODE_LENGTH_LIMIT);
+	}
+	assignCanonicalCodes(state -> codes);
+}
+
+void runHeader(BenchState* state)
+{
+	state -> writer -> position = 0;
+	writeBits(state -> writer, FORMAT_CANONICAL, 8);
+	writeCodeLengths(state -> writer, state -> codes);
+	flushBitWriter(state -> writer);
+	state -> headerSize = state -> writer -> position;
+}
+
+void runEncode(BenchState* state)
+{
+	state -> writer -> position = 0;
+	encodeData(state -> writer, state -> codes, state -> data, state -> size);
+	writeBits(state -> writer, state -> codes[PSEUDO_EOF_VALUE].bits, state -> codes[PSEUDO_EOF_VALUE].length);
+	flushBitWriter(state -> writer);
+	state -> dataSize = state -> writer -> position;
+}
+
+void runDecode(BenchState* state)
+{
+	// Table is built for every file the way unhuff does, so it is part of the stage
+	resetArena(state -> decodeArena);
+	DecodeTable* table = buildDecodeTable(state -> decodeArena, state -> codes);
+	BitReader* reader = createMemoryBitReader(state -> decodeArena, state -> writer -> buffer, state -> dataSize);
+	state -> outputSize = 0;
+	decodeIntoBuffer(reader, table, state -> output, state -> size, &state -> outputSize);
+}
+
+static void (*const STAGE_FUNCTIONS[STAGE_COUNT])(BenchState*) = {runHistogram, runTree, runCodes, runHeader, runEncode, runDecode};
+
+BenchResult benchmarkFile(const char* name, const unsigned char* data, size_t size)
+{
+	BenchState state;
+	state.data = data;
+	state.size = size;
+	state.treeArena = createArena(ARENA_BLOCK_SIZE);
+	state.codeArena = createArena(ARENA_BLOCK_SIZE);
+	state.decodeArena = createArena(ARENA_BLOCK_SIZE);
+	Arena* arena = createArena(ARENA_BLOCK_SIZE);
+	state.writer = createMemoryBitWriter(arena, getCompressedBound(size, DEFAULT_CODE_LENGTH_LIMIT));
+	state.output = arenaAlloc(arena, size + 1);
+
+	// Every stage is repeated until enough time has passed, its input is what the stage before produced
+	BenchResult result;
+	snprintf(result.name, sizeof(result.name), "%s", name);
+	result.size = size;
+	int stage;
+	for(stage = 0; stage < STAGE_COUNT; stage++)
+	{
+		long runs = 0;
+		double start = getSeconds();
+		double elapsed;
+		do
+		{
+			STAGE_FUNCTIONS[stage](&state);
+			runs++;
+			elapsed = getSeconds() - start;
+		}
+		while(elapsed < BENCH_MIN_SECONDS);
+		result.seconds[stage] = elapsed / runs;
+	}
+	result.compressedSize = state.headerSize + state.dataSize;
+	result.valid = (state.outputSize == size && memcmp(state.output, data, size) == 0);
+
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	result.peakMemory = usage.ru_maxrss;
+
+	freeArena(arena);
+	freeArena(state.decodeArena);
+	freeArena(state.codeArena);
+	freeArena(state.treeArena);
+	return result;
+}
+
+unsigned char* generateCorpus(int kind, size_t size)
+{
+	// Weight of every character, falling off more steeply for each kind
+	double weights[256];
+	double total = 0;
+	int i;
+	for(i = 0; i < 256; i++)
+	{
+		weights[i] = kind == 0 ? 1.0 : kind == 1 ? 1.0 / (i + 1) : (i == 0 ? 1.0 : weights[i - 1] * 0.5);
+		total += weights[i];
+	}
+
+	// Table of 64 Ki entries in proportion to the weights, every character at least once
+	unsigned char* table = malloc(1 << 16);
+	size_t filled = 0;
+	for(i = 0; i < 256; i++)
+	{
+		size_t count = (size_t)(weights[i] / total * ((1 << 16) - 256)) + 1;
+		memset(table + filled, i, count);
+		filled += count;
+	}
+	memset(table + filled, 0, (1 << 16) - filled);
+
+	// Fixed xorshift seed, so every run measures the same data
+	unsigned char* data = malloc(size);
+	uint64_t state = 0x9E3779B97F4A7C15ull;
+	size_t j;
+	for(j = 0; j < size; j++)
+	{
+		state ^= state << 13;
+		state ^= state >> 7;
+		state ^= state << 17;
+		data[j] = table[state >> 48];
+	}
+	free(table);
+	return data;
+}
+
+int getSizeClass(size_t size)
+{
+	int sizeClass = 0;
+	while(size >= CLASS_LIMITS[sizeClass])
+	{
+		sizeClass++;
+	}
+	return sizeClass;
+}
+
+double getThroughput(size_t size, double seconds)
+{
+	return seconds > 0 ? size / seconds / (1 << 20) : 0;
+}
+
+void printResults(BenchResult* results, int resultCount, int format)
+{
+	// Aggregate throughput of every size class, total bytes over total time
+	size_t classSizes[CLASS_COUNT] = {0};
+	double classSeconds[CLASS_COUNT][STAGE_COUNT] = {{0}};
+	int classFiles[CLASS_COUNT] = {0};
+	long peakMemory = 0;
+	int i;
+	int stage;
+	for(i = 0; i < resultCount; i++)
+	{
+		int sizeClass = getSizeClass(results[i].size);
+		classSizes[sizeClass] += results[i].size;
+		classFiles[sizeClass]++;
+		for(stage = 0; stage < STAGE_COUNT; stage++)
+		{
+			classSeconds[sizeClass][stage] += results[i].seconds[stage];
+		}
+		peakMemory = results[i].peakMemory > peakMemory ? results[i].peakMemory : peakMemory;
+	}
+
+	if(format == OUTPUT_CSV)
+	{
+		printf("file,class,bytes,compressed,ratio");
+		for(stage = 0; stage < STAGE_COUNT; stage++)
+		{
+			printf(",%s_mibs", STAGE_NAMES[stage]);
+		}
+		printf(",peak_rss_kib,valid\n");
+		for(i = 0; i < resultCount; i++)
+		{
+			BenchResult* result = &results[i];
+			printf("%s,%s,%zu,%zu,%.4f", result -> name, CLASS_NAMES[getSizeClass(result -> size)], result -> size,
+				result -> compressedSize, result -> size > 0 ? (double)result -> compressedSize / result -> size : 0);
+			for(stage = 0; stage < STAGE_COUNT; stage++)
+			{
+				printf(",%.2f", getThroughput(result -> size, result -> seconds[stage]));
+			}
+			printf(",%ld,%d\n", result -> peakMemory, result -> valid);
+		}
+	}
+	else if(format == OUTPUT_JSON)
+	{
+		printf("{\n  \"files\": [\n");
+		for(i = 0; i < resultCount; i++)
+		{
+			BenchResult* result = &results[i];
+			printf("    {\"file\": \"%s\", \"class\": \"%s\", \"bytes\": %zu, \"compressed\": %zu, \"ratio\": %.4f, ",
+				result -> name, CLASS_NAMES[getSizeClass(result -> size)], result -> size, result -> compressedSize,
+				result -> size > 0 ? (double)result -> compressedSize / result -> size : 0);
+			for(stage = 0; stage < STAGE_COUNT; stage++)
+			{
+				printf("\"%s_mibs\": %.2f, ", STAGE_NAMES[stage], getThroughput(result -> size, result -> seconds[stage]));
+			}
+			printf("\"peak_rss_kib\": %ld, \"valid\": %s}%s\n", result -> peakMemory, result -> valid ? "true" : "false",
+				i + 1 < resultCount ? "," : "");
+		}
+		printf("  ],\n  \"classes\": [\n");
+		bool first = true;
+		for(i = 0; i < CLASS_COUNT; i++)
+		{
+			if(classFiles[i] == 0)
+			{
+				continue;
+			}
+			printf("%s    {\"class\": \"%s\", \"files\": %d, \"bytes\": %zu", first ? "" : ",\n", CLASS_NAMES[i], classFiles[i], classSizes[i]);
+			for(stage = 0; stage < STAGE_COUNT; stage++)
+			{
+				printf(", \"%s_mibs\": %.2f", STAGE_NAMES[stage], getThroughput(classSizes[i], classSeconds[i][stage]));
+			}
+			printf("}");
+			first = false;
+		}
+		printf("\n  ],\n  \"peak_rss_kib\": %ld\n}\n", peakMemory);
+	}
+	else
+	{
+		printf("%-24s %10s %7s", "file", "bytes", "ratio");
+		for(stage = 0; stage < STAGE_COUNT; stage++)
+		{
+			printf(" %10s", STAGE_NAMES[stage]);
+		}
+		printf("\n");
+		for(i = 0; i < resultCount; i++)
+		{
+			BenchResult* result = &results[i];
+			printf("%-24s %10zu %7.3f", result -> name, result -> size,
+				result -> size > 0 ? (double)result -> compressedSize / result -> size : 0);
+			for(stage = 0; stage < STAGE_COUNT; stage++)
+			{
+				printf(" %10.1f", getThroughput(result -> size, result -> seconds[stage]));
+			}
+			printf("%s\n", result -> valid ? "" : "  DECODE MISMATCH");
+		}
+		printf("\n%-24s %10s %7s", "class", "bytes", "files");
+		for(stage = 0; stage < STAGE_COUNT; stage++)
+		{
+			printf(" %10s", STAGE_NAMES[stage]);
+		}
+		printf("\n");
+		for(i = 0; i < CLASS_COUNT; i++)
+		{
+			if(classFiles[i] == 0)
+			{
+				continue;
+			}
+			printf("%-24s %10zu %7d", CLASS_NAMES[i], classSizes[i], classFiles[i]);
+			for(stage = 0; stage < STAGE_COUNT; stage++)
+			{
+				printf(" %10.1f", getThroughput(classSizes[i], classSeconds[i][stage]));
+			}
+			printf("\n");
+		}
+		printf("\nThroughput in MiB/s of input, peak RSS %ld KiB\n", peakMemory);
+	}
+}
+
+int compareBaseline(BenchResult* results, int resultCount, char* filename)
+{
+	FILE* fp = fopen(filename, "r");
+	if(fp == NULL)
+	{
+		fprintf(stderr, "Cannot open %s\n", filename);
+		return -1;
+	}
+
+	// Rows of a previous --csv run, matched to this run by file name
+	int regressions = 0;
+	char line[1024];
+	while(fgets(line, sizeof(line), fp) != NULL)
+	{
+		char* name = strtok(line, ",");
+		int i = 0;
+		while(name != NULL && i < resultCount && strcmp(results[i].name, name) != 0)
+		{
+			i++;
+		}
+		if(name == NULL || i == resultCount)
+		{
+			continue;
+		}
+
+		// Skip class, sizes and ratio, then compare every stage's throughput
+		int field;
+		for(field = 0; field < 4; field++)
+		{
+			strtok(NULL, ",");
+		}
+		int stage;
+		for(stage = 0; stage < STAGE_COUNT; stage++)
+		{
+			char* value = strtok(NULL, ",");
+			double before = value != NULL ? atof(value) : 0;
+			double after = getThroughput(results[i].size, results[i].seconds[stage]);
+			if(before > 0 && after < before * (1 - BENCH_REGRESSION_THRESHOLD))
+			{
+				fprintf(stderr, "REGRESSION %s %s: %.1f -> %.1f MiB/s (%+.1f%%)\n", results[i].name, STAGE_NAMES[stage],
+					before, after, (after / before - 1) * 100);
+				regressions++;
+			}
+		}
+	}
+	fclose(fp);
+	fprintf(stderr, "%d regressions against %s\n", regressions, filename);
+	return regressions;
+}
+
+int main(int argc, char* argv[])
+{
+	int format = OUTPUT_TABLE;
+	size_t syntheticSize = 0;
+	char* saveDirectory = NULL;
+	char* baselineFilename = NULL;
+	char* files[BENCH_MAX_FILES];
+	int fileCount = 0;
+	int i;
+	for(i = 1; i < argc; i++)
+	{
+		if(strcmp(argv[i], "--csv") == 0)
+		{
+			format = OUTPUT_CSV;
+		}
+		else if(strcmp(argv[i], "--json") == 0)
+		{
+			format = OUTPUT_JSON;
+		}
+		else if(strcmp(argv[i], "--synthetic") == 0 && i + 1 < argc)
+		{
+			syntheticSize = (size_t)atol(argv[++i]) << 20;
+		}
+		else if(strcmp(argv[i], "--save") == 0 && i + 1 < argc)
+		{
+			saveDirectory = argv[++i];
+		}
+		else if(strcmp(argv[i], "--baseline") == 0 && i + 1 < argc)
+		{
+			baselineFilename = argv[++i];
+		}
+		else if(fileCount < BENCH_MAX_FILES - SYNTHETIC_COUNT)
+		{
+			files[fileCount++] = argv[i];
+		}
+	}
+	if(fileCount == 0 && syntheticSize == 0)
+	{
+		printf("Usage: bench_suite [--csv | --json] [--synthetic MiB] [--save directory] [--baseline results.csv] file...\n");
+		return EXIT_FAILURE;
+	}
+
+	BenchResult* results = malloc(sizeof(*results) * BENCH_MAX_FILES);
+	int resultCount = 0;
+	for(i = 0; i < fileCount; i++)
+	{
+		FILE* fp = fopen(files[i], "rb");
+		if(fp == NULL)
+		{
+			fprintf(stderr, "Cannot open %s\n", files[i]);
+			continue;
+		}
+		fseek(fp, 0, SEEK_END);
+		size_t size = ftell(fp);
+		fseek(fp, 0, SEEK_SET);
+		unsigned char* data = malloc(size + 1);
+		size = fread(data, 1, size, fp);
+		fclose(fp);
+
+		const char* name = strrchr(files[i], '/') != NULL ? strrchr(files[i], '/') + 1 : files[i];
+		results[resultCount++] = benchmarkFile(name, data, size);
+		free(data);
+	}
+
+	// Synthetic corpora are generated in memory, and written out when asked so the tools can be run on them
+	for(i = 0; syntheticSize > 0 && i < SYNTHETIC_COUNT; i++)
+	{
+		char name[64];
+		snprintf(name, sizeof(name), "synthetic-%s-%zuM", SYNTHETIC_NAMES[i], syntheticSize >> 20);
+		unsigned char* data = generateCorpus(i, syntheticSize);
+		if(saveDirectory != NULL)
+		{
+			char path[1024];
+			snprintf(path, sizeof(path), "%s/%s", saveDirectory, name);
+			FILE* fp = fopen(path, "wb");
+			if(fp == NULL || fwrite(data, 1, syntheticSize, fp) != syntheticSize)
+			{
+				fprintf(stderr, "Cannot write %s\n", path);
+			}
+			if(fp != NULL)
+			{
+				fclose(fp);
+			}
+		}
+		results[resultCount++] = benchmarkFile(name, data, syntheticSize);
+		free(data);
+	}
+
+	printResults(results, resultCount, format);
+
+	// Failing the run on a regression or a decode mismatch makes either visible to scripts
+	bool valid = true;
+	for(i = 0; i < resultCount; i++)
+	{
+		valid = valid && results[i].valid;
+	}
+	int regressions = baselineFilename != NULL ? compareBaseline(results, resultCount, baselineFilename) : 0;
+	free(results);
+	return valid && regressions == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
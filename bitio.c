@@ -0,0 +1,424 @@
+#include "huff.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+BitWriter* createBitWriter(Arena* arena, OutputFile* output)
+{
+	// Initialize empty register, bits go straight into the output's buffer
+	BitWriter* writer = arenaAlloc(arena, sizeof(*writer));
+	writer -> bits = 0;
+	writer -> count = 0;
+	writer -> output = output;
+	attachOutput(writer);
+
+	return writer;
+}
+
+BitWriter* createMemoryBitWriter(Arena* arena, size_t capacity)
+{
+	capacity = (capacity + 3) & ~(size_t)3;
+	return createBufferBitWriter(arena, arenaAlloc(arena, capacity), capacity);
+}
+
+BitWriter* createBufferBitWriter(Arena* arena, unsigned char* buffer, size_t capacity)
+{
+	// Output stays in the buffer, which must be big enough for all of it
+	BitWriter* writer = arenaAlloc(arena, sizeof(*writer));
+	writer -> bits = 0;
+	writer -> count = 0;
+	writer -> capacity = capacity;
+	writer -> buffer = buffer;
+	writer -> position = 0;
+	writer -> output = NULL;
+
+	return writer;
+}
+
+void writeBits(BitWriter* writer, uint64_t bits, int length)
+{
+	// Codes longer than a word are written in two halves
+	if(length > 32)
+	{
+		writeBits(writer, bits >> 32, length - 32);
+		length = 32;
+	}
+
+	// Shift bits into the register, keeping them right-aligned
+	writer -> bits = (writer -> bits << length) | (bits & (((uint64_t)1 << length) - 1));
+	writer -> count += length;
+
+	// Once a whole word is pending, move it to the buffer most significant byte first
+	if(writer -> count >= 32)
+	{
+		writer -> count -= 32;
+		uint32_t word = (uint32_t)(writer -> bits >> writer -> count);
+		unsigned char* out = writer -> buffer + writer -> position;
+		out[0] = word >> 24;
+		out[1] = word >> 16;
+		out[2] = word >> 8;
+		out[3] = word;
+		writer -> position += 4;
+
+		// If buffer is full, hand it to the output file and continue in the next one
+		if(writer -> position == writer -> capacity && writer -> output != NULL)
+		{
+			writer -> output -> position = writer -> position;
+			submitOutput(writer -> output);
+			attachOutput(writer);
+		}
+	}
+}
+
+void flushBitWriter(BitWriter* writer)
+{
+	// Pad last byte with zeros if needed
+	if(writer -> count % 8 != 0)
+	{
+		writeBits(writer, 0, 8 - (writer -> count % 8));
+	}
+
+	// Move remaining whole bytes out of the register
+	while(writer -> count > 0)
+	{
+		writer -> count -= 8;
+		writer -> buffer[writer -> position++] = (unsigned char)(writer -> bits >> writer -> count);
+	}
+	writer -> bits = 0;
+
+	// Give the output file everything in the buffer, memory writers keep it
+	if(writer -> output != NULL)
+	{
+		writer -> output -> position = writer -> position;
+		attachOutput(writer);
+	}
+}
+
+void rewindBitWriter(BitWriter* writer)
+{
+	// Memory writers only, file writers may have handed their bytes on already
+	writer -> bits = 0;
+	writer -> count = 0;
+	writer -> position = 0;
+}
+
+void writeBytes(BitWriter* writer, const unsigned char* data, size_t size)
+{
+	// Move whole bytes out of the register, the writer must be at a byte boundary
+	while(writer -> count > 0)
+	{
+		writer -> count -= 8;
+		writer -> buffer[writer -> position++] = (unsigned char)(writer -> bits >> writer -> count);
+	}
+	writer -> bits = 0;
+
+	// Files get the data after what is buffered, memory writers copy it in
+	if(writer -> output != NULL)
+	{
+		writer -> output -> position = writer -> position;
+		writeOutput(writer -> output, data, size);
+		attachOutput(writer);
+	}
+	else
+	{
+		memcpy(writer -> buffer + writer -> position, data, size);
+		writer -> position += size;
+	}
+}
+
+uint64_t getWriterOffset(BitWriter* writer)
+{
+	// Bytes handed to the output file before the buffer, those in it and those in the register
+	uint64_t offset = writer -> output != NULL ? writer -> output -> offset : 0;
+	return offset + writer -> position + writer -> count / 8;
+}
+
+void attachOutput(BitWriter* writer)
+{
+	// Continue in the output's buffer at a word boundary, the bytes after the last whole word are taken
+	// back into the register and written again. The register is empty whenever there are such bytes,
+	// since a full buffer that was handed over leaves none
+	OutputFile* output = writer -> output;
+	int extra = output -> position % 4;
+	writer -> buffer = output -> buffer;
+	writer -> capacity = output -> capacity;
+	writer -> position = output -> position - extra;
+	int i;
+	for(i = 0; i < extra; i++)
+	{
+		writer -> bits = (writer -> bits << 8) | writer -> buffer[writer -> position + i];
+		writer -> count += 8;
+	}
+}
+
+void writeGamma(BitWriter* writer, uint32_t value)
+{
+	// Count significant bits, then write one less zeros followed by the value itself
+	int length = 0;
+	while((value >> length) > 1)
+	{
+		length++;
+	}
+	writeBits(writer, 0, length);
+	writeBits(writer, value, length + 1);
+}
+
+BitReader* createBitReader(Arena* arena, FILE* fp)
+{
+	// Initialize empty register and input buffer
+	BitReader* reader = arenaAlloc(arena, sizeof(*reader));
+	reader -> bits = 0;
+	reader -> count = 0;
+	reader -> buffer = arenaAlloc(arena, BIT_BUFFER_SIZE);
+	reader -> position = 0;
+	reader -> size = 0;
+	reader -> bytesRead = 0;
+	reader -> overrun = 0;
+	reader -> fp = fp;
+	reader -> readAhead = NULL;
+
+	return reader;
+}
+
+BitReader* createMemoryBitReader(Arena* arena, const unsigned char* data, size_t size)
+{
+	BitReader* reader = arenaAlloc(arena, sizeof(*reader));
+	initMemoryBitReader(reader, data, size);
+
+	return reader;
+}
+
+void initMemoryBitReader(BitReader* reader, const unsigned char* data, size_t size)
+{
+	// The whole input is the buffer, nothing is read from a file
+	reader -> bits = 0;
+	reader -> count = 0;
+	reader -> buffer = (unsigned char*)data;
+	reader -> position = 0;
+	reader -> size = size;
+	reader -> bytesRead = size;
+	reader -> overrun = 0;
+	reader -> fp = NULL;
+	reader -> readAhead = NULL;
+}
+
+void refillBits(BitReader* reader)
+{
+	while(reader -> count <= 56)
+	{
+		// If at least a word is buffered, load it at once and keep the whole bytes that fit
+		if(reader -> position + 8 <= reader -> size)
+		{
+			const unsigned char* in = reader -> buffer + reader -> position;
+			uint64_t word = ((uint64_t)in[0] << 56) | ((uint64_t)in[1] << 48) | ((uint64_t)in[2] << 40) | ((uint64_t)in[3] << 32) |
+					((uint64_t)in[4] << 24) | ((uint64_t)in[5] << 16) | ((uint64_t)in[6] << 8) | (uint64_t)in[7];
+			reader -> bits |= word >> reader -> count;
+			int bytes = (63 - reader -> count) >> 3;
+			reader -> position += bytes;
+			reader -> count += bytes * 8;
+			return;
+		}
+
+		// If buffer is empty, read the next block of the file
+		if(reader -> position == reader -> size)
+		{
+			// Take whatever has arrived so pipes are not held up waiting for a full buffer
+			if(reader -> readAhead != NULL)
+			{
+				takeReadAheadBlock(reader);
+			}
+			else
+			{
+				ssize_t bytes = 0;
+				if(reader -> fp != NULL)
+				{
+					bytes = read(fileno(reader -> fp), reader -> buffer, BIT_BUFFER_SIZE);
+					STATS_ADD(STATS_READ_CALLS, 1);
+				}
+				reader -> size = bytes > 0 ? bytes : 0;
+				reader -> bytesRead += reader -> size;
+				reader -> position = 0;
+			}
+
+			// Past end of file, supply zero bytes
+			if(reader -> size == 0)
+			{
+				reader -> overrun++;
+				reader -> count += 8;
+				continue;
+			}
+		}
+		reader -> bits |= (uint64_t)reader -> buffer[reader -> position++] << (56 - reader -> count);
+		reader -> count += 8;
+	}
+}
+
+uint32_t readBits(BitReader* reader, int length)
+{
+	if(length == 0)
+	{
+		return 0;
+	}
+	if(reader -> count < length)
+	{
+		refillBits(reader);
+	}
+
+	// Take bits from the top of the register
+	uint32_t value = (uint32_t)(reader -> bits >> (64 - length));
+	reader -> bits <<= length;
+	reader -> count -= length;
+	return value;
+}
+
+uint32_t peekBits(BitReader* reader, int length)
+{
+	if(reader -> count < length)
+	{
+		refillBits(reader);
+	}
+	return (uint32_t)(reader -> bits >> (64 - length));
+}
+
+void alignToByte(BitReader* reader)
+{
+	// Whole bytes are loaded into the register, so the bits left of the current byte are the remainder
+	readBits(reader, reader -> count % 8);
+}
+
+size_t readBytes(BitReader* reader, unsigned char* output, size_t size)
+{
+	// Whole bytes in the register come first, except zero bytes supplied past end of file
+	size_t copied = 0;
+	while(copied < size && reader -> count >= 8 * (reader -> overrun + 1))
+	{
+		output[copied++] = (unsigned char)(reader -> bits >> 56);
+		reader -> bits <<= 8;
+		reader -> count -= 8;
+	}
+
+	// Bits past the count may hold bytes of the buffer about to be copied, clear them for the next refill
+	if(copied < size)
+	{
+		reader -> bits = 0;
+	}
+
+	// Then bytes left in the buffer
+	size_t buffered = reader -> size - reader -> position;
+	if(buffered > size - copied)
+	{
+		buffered = size - copied;
+	}
+	memcpy(output + copied, reader -> buffer + reader -> position, buffered);
+	reader -> position += buffered;
+	copied += buffered;
+
+	// Then the blocks read ahead, keeping what is left of the last one
+	while(copied < size && reader -> readAhead != NULL && takeReadAheadBlock(reader) > 0)
+	{
+		buffered = reader -> size < size - copied ? reader -> size : size - copied;
+		memcpy(output + copied, reader -> buffer, buffered);
+		reader -> position = buffered;
+		copied += buffered;
+	}
+
+	// Or straight from the file, only as much as was asked for
+	while(copied < size && reader -> readAhead == NULL && reader -> fp != NULL)
+	{
+		ssize_t bytes = read(fileno(reader -> fp), output + copied, size - copied);
+		STATS_ADD(STATS_READ_CALLS, 1);
+		if(bytes <= 0)
+		{
+			break;
+		}
+		copied += bytes;
+		reader -> bytesRead += bytes;
+	}
+	return copied;
+}
+
+unsigned long getReaderOffset(BitReader* reader)
+{
+	// Bytes read so far, less those still in the buffer or the register
+	return reader -> bytesRead - (reader -> size - reader -> position) - reader -> count / 8;
+}
+
+void startPrefetch(BitReader* reader)
+{
+	// Regular files already read to the end have nothing left to read ahead
+	struct stat status;
+	if(reader -> fp == NULL || reader -> readAhead != NULL || (fstat(fileno(reader -> fp), &status) == 0 &&
+		S_ISREG(status.st_mode) && (uint64_t)status.st_size <= reader -> bytesRead))
+	{
+		return;
+	}
+	reader -> readAhead = startReadAhead(fileno(reader -> fp), READ_AHEAD_BLOCKS, BIT_BUFFER_SIZE, false);
+}
+
+bool stopPrefetch(BitReader* reader)
+{
+	// The buffer was a block of the ring, nothing more can be read
+	if(reader -> readAhead == NULL)
+	{
+		return true;
+	}
+	bool success = stopReadAhead(reader -> readAhead);
+	reader -> readAhead = NULL;
+	reader -> buffer = NULL;
+	reader -> size = 0;
+	reader -> position = 0;
+	reader -> fp = NULL;
+	return success;
+}
+
+size_t takeReadAheadBlock(BitReader* reader)
+{
+	// The reader's buffer becomes the next block, the one before goes back to the reader thread
+	reader -> size = takeReadAhead(reader -> readAhead);
+	reader -> buffer = (unsigned char*)reader -> readAhead -> block;
+	reader -> bytesRead += reader -> size;
+	reader -> position = 0;
+	return reader -> size;
+}
+
+uint32_t readGamma(BitReader* reader)
+{
+	// Leading zeros give the number of bits following the first one
+	int length = 0;
+	while(readBits(reader, 1) == 0 && length < 32)
+	{
+		length++;
+	}
+	if(length == 32)
+	{
+		return 0;
+	}
+	return ((uint32_t)1 << length) | readBits(reader, length);
+}
+
+void writeUint32(unsigned char* buffer, uint32_t value)
+{
+	// Most significant byte first, like the bit streams
+	buffer[0] = value >> 24;
+	buffer[1] = value >> 16;
+	buffer[2] = value >> 8;
+	buffer[3] = value;
+}
+
+uint32_t readUint32(const unsigned char* buffer)
+{
+	return ((uint32_t)buffer[0] << 24) | ((uint32_t)buffer[1] << 16) | ((uint32_t)buffer[2] << 8) | buffer[3];
+}
+
+void writeUint64(unsigned char* buffer, uint64_t value)
+{
+	writeUint32(buffer, value >> 32);
+	writeUint32(buffer + 4, (uint32_t)value);
+}
+
+uint64_t readUint64(const unsigned char* buffer)
+{
+	return ((uint64_t)readUint32(buffer) << 32) | readUint32(buffer + 4);
+}
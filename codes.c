@@ -0,0 +1,455 @@
+#include "huff.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+Tree* createTree(Arena* arena, unsigned long* frequencies)
+{
+	// Add a leaf for every character that appears, then sort leaves by frequency
+	Tree* tree = createEmptyTree(arena);
+	int i;
+	for(i = 0; i < ASCII_COUNT; i++)
+	{
+		if(frequencies[i] != 0)
+		{
+			addNode(tree, i, frequencies[i], -1, -1);
+		}
+	}
+	int leafCount = tree -> nodeCount;
+	qsort(tree -> nodes, leafCount, sizeof(*tree -> nodes), compareNodes);
+
+	// Parents are created in ascending frequency, so leaves and parents form two sorted queues
+	// and the two lightest nodes are always at the front of one of them
+	int nextLeaf = 0;
+	int nextParent = leafCount;
+	for(i = 1; i < leafCount; i++)
+	{
+		int children[2];
+		int j;
+		for(j = 0; j < 2; j++)
+		{
+			// On equal frequency take the leaf first, keeping the tree shallow
+			if(nextLeaf < leafCount && (nextParent == tree -> nodeCount ||
+				tree -> nodes[nextLeaf].frequency <= tree -> nodes[nextParent].frequency))
+			{
+				children[j] = nextLeaf++;
+			}
+			else
+			{
+				children[j] = nextParent++;
+			}
+		}
+		unsigned long frequency = tree -> nodes[children[0]].frequency + tree -> nodes[children[1]].frequency;
+		addNode(tree, 'X', frequency, children[0], children[1]);
+	}
+
+	// Last node created is the root, or the only leaf if there was nothing to pair
+	tree -> root = tree -> nodeCount - 1;
+	return tree;
+}
+
+void getBitEncodings(Tree* encodingTree, Code* codeTable)
+{
+	// Characters that do not appear in the file keep an empty code
+	memset(codeTable, 0, sizeof(*codeTable) * ASCII_COUNT);
+	getCodes(encodingTree, encodingTree -> root, codeTable, 0, 0);
+}
+
+void getCodes(Tree* tree, int node, Code* codeTable, uint64_t bits, int length)
+{
+	Node* current = &tree -> nodes[node];
+
+	// If left child exists, append a zero to bit code and recurse on left child
+	if(current -> leftChild != -1)
+	{
+		getCodes(tree, current -> leftChild, codeTable, bits << 1, length + 1);
+	}
+	
+	// If right child exists, append a one to bit code and recurse on right child
+	if(current -> rightChild != -1)
+	{
+		getCodes(tree, current -> rightChild, codeTable, (bits << 1) | 1, length + 1);
+	}
+
+	// If node is a leaf node, store its code at the character's index
+	if((current -> leftChild == -1) && (current -> rightChild == -1))
+	{
+		codeTable[current -> value].bits = bits;
+		codeTable[current -> value].length = length;
+	}	
+}
+
+void assignCanonicalCodes(Code* codeTable)
+{
+	// Count how many codes there are of every length
+	int lengthCounts[MAX_CODE_LENGTH + 1] = {0};
+	int i;
+	for(i = 0; i < ASCII_COUNT; i++)
+	{
+		lengthCounts[codeTable[i].length]++;
+	}
+	lengthCounts[0] = 0;
+
+	// Find the first code of every length, shorter codes come first
+	uint64_t nextCode[MAX_CODE_LENGTH + 1] = {0};
+	uint64_t code = 0;
+	for(i = 1; i <= MAX_CODE_LENGTH; i++)
+	{
+		code = (code + lengthCounts[i - 1]) << 1;
+		nextCode[i] = code;
+	}
+
+	// Codes of the same length are consecutive in character order
+	for(i = 0; i < ASCII_COUNT; i++)
+	{
+		if(codeTable[i].length != 0)
+		{
+			codeTable[i].bits = nextCode[codeTable[i].length]++;
+		}
+	}
+}
+
+void buildCanonicalCodes(Arena* arena, unsigned long* frequencies, int lengthLimit, Code* codeTable)
+{
+	// Huffman code lengths, unless the tree is deeper than the limit allows
+	Tree* tree = createTree(arena, frequencies);
+	getBitEncodings(tree, codeTable);
+	if(getMaxCodeLength(codeTable) > lengthLimit)
+	{
+		limitCodeLengths(arena, frequencies, codeTable, lengthLimit);
+	}
+	assignCanonicalCodes(codeTable);
+}
+
+size_t getCompressedBound(size_t size, int lengthLimit)
+{
+	// Every character and Pseudo-EOF at the longest length, plus the largest code length header
+	return ((size + 1) * lengthLimit + 7) / 8 + CODE_LENGTHS_BOUND;
+}
+
+int getMaxCodeLength(Code* codeTable)
+{
+	int maxLength = 0;
+	int i;
+	for(i = 0; i < ASCII_COUNT; i++)
+	{
+		if(codeTable[i].length > maxLength)
+		{
+			maxLength = codeTable[i].length;
+		}
+	}
+	return maxLength;
+}
+
+void limitCodeLengths(Arena* arena, unsigned long* frequencies, Code* codeTable, int limit)
+{
+	// Collect the characters that appear, lightest first
+	PackageItem leaves[ASCII_COUNT];
+	int leafCount = 0;
+	int i;
+	for(i = 0; i < ASCII_COUNT; i++)
+	{
+		codeTable[i].length = 0;
+		if(frequencies[i] != 0)
+		{
+			leaves[leafCount].weight = frequencies[i];
+			leaves[leafCount].symbol = i;
+			leafCount++;
+		}
+	}
+	if(leafCount < 2)
+	{
+		return;
+	}
+	qsort(leaves, leafCount, sizeof(*leaves), comparePackageItems);
+
+	// One list per bit of code length, the first holds only the leaves
+	PackageItem* lists = arenaAlloc(arena, sizeof(*lists) * limit * leafCount * 2);
+	int* listSizes = arenaAlloc(arena, sizeof(*listSizes) * limit);
+	memcpy(lists, leaves, sizeof(*leaves) * leafCount);
+	listSizes[0] = leafCount;
+
+	// Every other list merges the leaves with packages of pairs from the list before
+	int level;
+	for(level = 1; level < limit; level++)
+	{
+		PackageItem* previous = lists + (level - 1) * leafCount * 2;
+		PackageItem* current = lists + level * leafCount * 2;
+		int packageCount = listSizes[level - 1] / 2;
+		int leaf = 0;
+		int package = 0;
+		int size = 0;
+		while(leaf < leafCount || package < packageCount)
+		{
+			uint64_t packageWeight = package < packageCount ? previous[2 * package].weight + previous[2 * package + 1].weight : 0;
+			if(package >= packageCount || (leaf < leafCount && leaves[leaf].weight <= packageWeight))
+			{
+				current[size++] = leaves[leaf++];
+			}
+			else
+			{
+				current[size].weight = packageWeight;
+				current[size].symbol = -1;
+				size++;
+				package++;
+			}
+		}
+		listSizes[level] = size;
+	}
+
+	// Take the lightest 2n - 2 items of the last list, then follow the packages back down,
+	// every time a character is taken its code gets one bit longer
+	int taken = 2 * leafCount - 2;
+	for(level = limit - 1; level >= 0; level--)
+	{
+		PackageItem* current = lists + level * leafCount * 2;
+		int packages = 0;
+		for(i = 0; i < taken; i++)
+		{
+			if(current[i].symbol == -1)
+			{
+				packages++;
+			}
+			else
+			{
+				codeTable[current[i].symbol].length++;
+			}
+		}
+		taken = packages * 2;
+	}
+}
+
+int comparePackageItems(const void* x, const void* y)
+{
+	const PackageItem* a = x;
+	const PackageItem* b = y;
+	if(a -> weight != b -> weight)
+	{
+		return a -> weight < b -> weight ? -1 : 1;
+	}
+	return a -> symbol - b -> symbol;
+}
+
+Tree* createTreeFromCodes(Arena* arena, Code* codeTable)
+{
+	// A lone Pseudo-EOF character is the whole tree
+	Tree* tree = createEmptyTree(arena);
+	tree -> root = addNode(tree, PSEUDO_EOF_VALUE, 0, -1, -1);
+	if(codeTable[PSEUDO_EOF_VALUE].length == 0)
+	{
+		return tree;
+	}
+
+	// Follow every code from the root, creating the nodes on its path
+	tree -> nodes[tree -> root].value = 'X';
+	int i;
+	for(i = 0; i < ASCII_COUNT; i++)
+	{
+		int node = tree -> root;
+		int bit;
+		for(bit = codeTable[i].length - 1; bit >= 0; bit--)
+		{
+			int16_t* child = ((codeTable[i].bits >> bit) & 1) ? &tree -> nodes[node].rightChild : &tree -> nodes[node].leftChild;
+			if(*child == -1)
+			{
+				*child = addNode(tree, bit == 0 ? i : 'X', 0, -1, -1);
+			}
+			node = *child;
+		}
+	}
+	return tree;
+}
+
+void writeCodeLengths(BitWriter* writer, Code* codeTable)
+{
+	// Find how many bits every length needs and how many characters appear
+	int maxLength = getMaxCodeLength(codeTable);
+	int characterCount = 0;
+	int i;
+	for(i = 0; i < PSEUDO_EOF_VALUE; i++)
+	{
+		if(codeTable[i].length != 0)
+		{
+			characterCount++;
+		}
+	}
+	int lengthBits = 0;
+	while((maxLength >> lengthBits) != 0)
+	{
+		lengthBits++;
+	}
+
+	// An empty file has no codes at all
+	writeBits(writer, lengthBits, 3);
+	if(lengthBits == 0)
+	{
+		return;
+	}
+
+	// Every character is written as its distance from the previous one and its length
+	writeGamma(writer, characterCount + 1);
+	int previous = -1;
+	for(i = 0; i < PSEUDO_EOF_VALUE; i++)
+	{
+		if(codeTable[i].length != 0)
+		{
+			writeGamma(writer, i - previous);
+			writeBits(writer, codeTable[i].length, lengthBits);
+			previous = i;
+		}
+	}
+
+	// Pseudo-EOF character always appears, only its length is needed
+	writeBits(writer, codeTable[PSEUDO_EOF_VALUE].length, lengthBits);
+}
+
+bool readCodeLengths(BitReader* reader, Code* codeTable)
+{
+	memset(codeTable, 0, sizeof(*codeTable) * ASCII_COUNT);
+	// Headers that run past the end of the data are cut short, an empty one included
+	int lengthBits = readBits(reader, 3);
+	if(lengthBits == 0)
+	{
+		return reader -> count >= reader -> overrun * 8;
+	}
+	if(lengthBits > CODE_LENGTH_BITS)
+	{
+		return false;
+	}
+
+	// Walk forward through the characters by the stored distances
+	int characterCount = readGamma(reader) - 1;
+	int character = -1;
+	int i;
+	for(i = 0; i < characterCount; i++)
+	{
+		character += readGamma(reader);
+		if(character < 0 || character >= PSEUDO_EOF_VALUE)
+		{
+			return false;
+		}
+		codeTable[character].length = readBits(reader, lengthBits);
+		if(codeTable[character].length > MAX_CODE_LENGTH)
+		{
+			return false;
+		}
+	}
+	codeTable[PSEUDO_EOF_VALUE].length = readBits(reader, lengthBits);
+	return codeTable[PSEUDO_EOF_VALUE].length <= MAX_CODE_LENGTH && reader -> count >= reader -> overrun * 8;
+}
+
+int compareNodes(const void* x, const void* y)
+{
+	const Node* a = x;
+	const Node* b = y;
+	if(a -> frequency != b -> frequency)
+	{
+		return a -> frequency < b -> frequency ? -1 : 1;
+	}
+	return a -> value - b -> value;
+}
+
+Tree* createEmptyTree(Arena* arena)
+{
+	Tree* tree = arenaAlloc(arena, sizeof(*tree));
+	tree -> nodeCount = 0;
+	tree -> root = -1;
+
+	return tree;
+}
+
+int addNode(Tree* tree, int value, unsigned long frequency, int leftChild, int rightChild)
+{
+	// Initialize node at the end of the array
+	Node* node = &tree -> nodes[tree -> nodeCount];
+	node -> value = value;
+	node -> frequency = frequency;
+	node -> leftChild = leftChild;
+	node -> rightChild = rightChild;
+
+	return tree -> nodeCount++;
+}
+
+int getMaxDepth(Tree* tree, int node)
+{
+	if(node == -1)
+	{
+		return 0;
+	}
+	else
+	{
+		int leftDepth = getMaxDepth(tree, tree -> nodes[node].leftChild);
+		int rightDepth = getMaxDepth(tree, tree -> nodes[node].rightChild);
+
+		// Add up depth of left and right sub-trees and add the largest to current depth
+		if(rightDepth > leftDepth)
+		{
+			return rightDepth + 1;
+		}
+		else
+		{
+			return leftDepth + 1;
+		}
+	}
+}
+
+void printTree(Tree* tree, int node, int space)
+{
+	// Base case
+	if(node == -1)
+	{
+		return;
+	}
+	// Add level of spacing per iteration
+	space += 6; 
+
+	// Recurse on right child
+	printTree(tree, tree -> nodes[node].rightChild, space); 
+	printf("\n");
+	int i;
+
+	// Space out node from rest
+	for (i = 6; i < space; i++)
+	{
+		printf(" "); 
+	}
+
+	// Print node
+	printNode(&tree -> nodes[node]);
+
+	// Recurse on left child
+	printTree(tree, tree -> nodes[node].leftChild, space); 
+}
+
+void printNode(Node* node)
+{
+	if(node -> value == '\n')
+	{
+		printf("Node: (\\n, %ld)\n", node -> frequency);
+	}
+	else if(node -> value == ' ')
+	{
+		printf("Node: ( , %ld)\n", node -> frequency);
+	}
+	else if(node -> value == PSEUDO_EOF_VALUE)
+	{
+		printf("Node: (EOF, %ld)\n",node -> frequency);
+	}
+	else
+	{
+		printf("Node: (%d, %ld)\n", node -> value, node -> frequency);
+	}
+}
+
+void printByte(int byte)
+{
+	printf("Byte: ");
+	int i;
+	
+	// Print the bits of the byte
+	for(i = 7; i >= 0; i--)
+	{
+		printf("%c", (byte & (1 << i)) ? '1' : '0');
+	}
+	printf("\n");
+}
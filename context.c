@@ -0,0 +1,304 @@
+#include "huff.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+ContextModel* buildContextModel(Arena* arena, const unsigned char* data, size_t size, int lengthLimit)
+{
+	// Count every character after every character, the first one after a zero
+	unsigned long (*pairs)[ASCII_COUNT] = arenaAlloc(arena, CONTEXT_COUNT * sizeof(*pairs));
+	memset(pairs, 0, CONTEXT_COUNT * sizeof(*pairs));
+	unsigned char previous = 0;
+	size_t i;
+	for(i = 0; i < size; i++)
+	{
+		pairs[previous][data[i]]++;
+		previous = data[i];
+	}
+
+	// Every context starts out sharing one table. A context gets its own table when its entropy and
+	// header take fewer bits than coding it with the shared counts, which settle over a few rounds
+	bool own[CONTEXT_COUNT] = {false};
+	unsigned long shared[ASCII_COUNT];
+	int context;
+	int round;
+	for(round = 0; round < CONTEXT_ROUNDS; round++)
+	{
+		sumSharedCounts(pairs, own, shared);
+		for(context = 0; context < CONTEXT_COUNT; context++)
+		{
+			double ownBits = getContextCost(pairs[context], pairs[context]) + getTableCost(pairs[context]);
+			own[context] = ownBits < getContextCost(pairs[context], shared);
+		}
+	}
+	sumSharedCounts(pairs, own, shared);
+
+	// Own tables in context order, then the shared one
+	ContextModel* model = arenaAlloc(arena, sizeof(*model));
+	model -> tableCount = 0;
+	for(context = 0; context < CONTEXT_COUNT; context++)
+	{
+		model -> tableCount += own[context];
+	}
+	model -> tableCount++;
+	model -> codes = arenaAlloc(arena, model -> tableCount * sizeof(*model -> codes));
+	model -> tables = NULL;
+	model -> previous = 0;
+
+	// Every table can code Pseudo-EOF, since the file may end in any context
+	int table = 0;
+	for(context = 0; context < CONTEXT_COUNT; context++)
+	{
+		if(own[context])
+		{
+			pairs[context][PSEUDO_EOF_VALUE] = PSEUDO_EOF_FREQUENCY;
+			buildCanonicalCodes(arena, pairs[context], lengthLimit, model -> codes[table]);
+			model -> tableOf[context] = table++;
+		}
+		else
+		{
+			model -> tableOf[context] = model -> tableCount - 1;
+		}
+	}
+	shared[PSEUDO_EOF_VALUE] = PSEUDO_EOF_FREQUENCY;
+	buildCanonicalCodes(arena, shared, lengthLimit, model -> codes[table]);
+
+	// Exact size of the data with these codes, estimated size of the headers
+	model -> bits = 0;
+	int character;
+	for(context = 0; context < CONTEXT_COUNT; context++)
+	{
+		Code* codes = model -> codes[model -> tableOf[context]];
+		for(character = 0; character < PSEUDO_EOF_VALUE; character++)
+		{
+			model -> bits += (uint64_t)pairs[context][character] * codes[character].length;
+		}
+		if(own[context])
+		{
+			model -> bits += getTableCost(pairs[context]);
+		}
+	}
+	model -> bits += getTableCost(shared);
+
+	return model;
+}
+
+void writeContextModel(BitWriter* writer, ContextModel* model)
+{
+	// Contexts with their own table as distances from the previous one, then every table's code lengths
+	writeGamma(writer, model -> tableCount);
+	int previous = -1;
+	int context;
+	for(context = 0; context < CONTEXT_COUNT; context++)
+	{
+		if(model -> tableOf[context] != model -> tableCount - 1)
+		{
+			writeGamma(writer, context - previous);
+			previous = context;
+		}
+	}
+	int table;
+	for(table = 0; table < model -> tableCount; table++)
+	{
+		writeCodeLengths(writer, model -> codes[table]);
+	}
+}
+
+void encodeContexts(BitWriter* writer, ContextModel* model, const unsigned char* data, size_t size)
+{
+	// Codes of the table for every context, looked up by the character before
+	Code* codes[CONTEXT_COUNT];
+	int context;
+	for(context = 0; context < CONTEXT_COUNT; context++)
+	{
+		codes[context] = model -> codes[model -> tableOf[context]];
+	}
+
+	unsigned char previous = 0;
+	size_t i;
+	for(i = 0; i < size; i++)
+	{
+		writeBits(writer, codes[previous][data[i]].bits, codes[previous][data[i]].length);
+		previous = data[i];
+	}
+	writeBits(writer, codes[previous][PSEUDO_EOF_VALUE].bits, codes[previous][PSEUDO_EOF_VALUE].length);
+}
+
+ContextModel* readContextModel(Arena* arena, BitReader* reader)
+{
+	ContextModel* model = arenaAlloc(arena, sizeof(*model));
+	model -> tableCount = readGamma(reader);
+	if(model -> tableCount < 1 || model -> tableCount > CONTEXT_COUNT + 1)
+	{
+		return NULL;
+	}
+
+	// Contexts not listed use the shared table, which comes last
+	int context;
+	for(context = 0; context < CONTEXT_COUNT; context++)
+	{
+		model -> tableOf[context] = model -> tableCount - 1;
+	}
+	context = -1;
+	int table;
+	for(table = 0; table < model -> tableCount - 1; table++)
+	{
+		uint32_t distance = readGamma(reader);
+		if(distance == 0 || context + distance >= CONTEXT_COUNT)
+		{
+			return NULL;
+		}
+		context += distance;
+		model -> tableOf[context] = table;
+	}
+
+	// Tables resolve one character at a time, since the next character is looked up in another table
+	model -> codes = arenaAlloc(arena, model -> tableCount * sizeof(*model -> codes));
+	model -> tables = arenaAlloc(arena, model -> tableCount * sizeof(*model -> tables));
+	model -> lookahead = CONTEXT_DECODE_BITS;
+	for(table = 0; table < model -> tableCount; table++)
+	{
+		if(!readCodeLengths(reader, model -> codes[table]))
+		{
+			return NULL;
+		}
+		assignCanonicalCodes(model -> codes[table]);
+		DecodeTable* decodeTable = createDecodeTableOfWidth(arena, model -> codes[table], CONTEXT_DECODE_BITS);
+		if(decodeTable -> maxLength > model -> lookahead)
+		{
+			model -> lookahead = decodeTable -> maxLength;
+		}
+
+		// A table of only Pseudo-EOF resolves it from every entry without reading a bit
+		if(decodeTable -> maxLength == 0)
+		{
+			uint32_t entry;
+			for(entry = 0; entry < decodeTable -> size; entry++)
+			{
+				decodeTable -> entries[entry].symbol = PSEUDO_EOF_VALUE;
+				decodeTable -> entries[entry].count = 1;
+			}
+		}
+		model -> tables[table] = decodeTable;
+	}
+	model -> previous = 0;
+	model -> bits = 0;
+
+	return model;
+}
+
+int decodeContexts(ContextModel* model, BitReader* reader, unsigned char* output, size_t capacity, size_t* position)
+{
+	// Decoding table of every context, looked up by the character before
+	DecodeTable* tables[CONTEXT_COUNT];
+	int context;
+	for(context = 0; context < CONTEXT_COUNT; context++)
+	{
+		tables[context] = model -> tables[model -> tableOf[context]];
+	}
+
+	size_t used = *position;
+	unsigned char previous = model -> previous;
+	int result = DECODE_FULL;
+	while(used < capacity)
+	{
+		if(reader -> count < model -> lookahead)
+		{
+			refillBits(reader);
+			if(reader -> overrun > 8)
+			{
+				result = DECODE_TRUNCATED;
+				break;
+			}
+		}
+
+		// Look up the next bits in the table of the previous character, following links to sub-tables
+		DecodeTable* table = tables[previous];
+		DecodeEntry* entry = &table -> entries[reader -> bits >> (64 - CONTEXT_DECODE_BITS)];
+		while(entry -> count == 0 && entry -> width != 0)
+		{
+			reader -> bits <<= entry -> length;
+			reader -> count -= entry -> length;
+			entry = &table -> entries[entry -> next + (reader -> bits >> (64 - entry -> width))];
+		}
+		if(entry -> count == 0)
+		{
+			result = DECODE_INVALID;
+			break;
+		}
+		reader -> bits <<= entry -> length;
+		reader -> count -= entry -> length;
+
+		if(entry -> symbol == PSEUDO_EOF_VALUE)
+		{
+			result = DECODE_END;
+			break;
+		}
+		output[used++] = entry -> symbol;
+		previous = entry -> symbol;
+	}
+
+	// Codes read from the zeros supplied past the end were never written, the data was cut short
+	if(reader -> count < reader -> overrun * 8)
+	{
+		result = DECODE_TRUNCATED;
+	}
+	model -> previous = previous;
+	*position = used;
+	return result;
+}
+
+void sumSharedCounts(unsigned long (*pairs)[ASCII_COUNT], bool* own, unsigned long* shared)
+{
+	memset(shared, 0, ASCII_COUNT * sizeof(*shared));
+	int context;
+	int character;
+	for(context = 0; context < CONTEXT_COUNT; context++)
+	{
+		if(!own[context])
+		{
+			for(character = 0; character < PSEUDO_EOF_VALUE; character++)
+			{
+				shared[character] += pairs[context][character];
+			}
+		}
+	}
+}
+
+double getContextCost(unsigned long* counts, unsigned long* model)
+{
+	// Bits the counts take at the entropy of the model, infinite if the model lacks a character they have
+	unsigned long countTotal = 0;
+	unsigned long modelTotal = 0;
+	int character;
+	for(character = 0; character < PSEUDO_EOF_VALUE; character++)
+	{
+		countTotal += counts[character];
+		modelTotal += model[character];
+	}
+	double bits = 0;
+	for(character = 0; character < PSEUDO_EOF_VALUE && countTotal > 0; character++)
+	{
+		if(counts[character] != 0)
+		{
+			if(model[character] == 0)
+			{
+				return INFINITY;
+			}
+			bits -= counts[character] * log2((double)model[character] / modelTotal);
+		}
+	}
+	return bits;
+}
+
+double getTableCost(unsigned long* counts)
+{
+	int characterCount = 0;
+	int character;
+	for(character = 0; character < PSEUDO_EOF_VALUE; character++)
+	{
+		characterCount += (counts[character] != 0);
+	}
+	return CONTEXT_TABLE_BITS + characterCount * CONTEXT_CHARACTER_BITS;
+}
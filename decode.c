@@ -0,0 +1,615 @@
+#include "huff.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+int readFormat(BitReader* reader)
+{
+	// Look at the first byte without consuming it
+	refillBits(reader);
+	int tag = (int)(reader -> bits >> 56);
+	if((tag & FORMAT_TAG_MASK) != FORMAT_TAG)
+	{
+		return FORMAT_TREE;
+	}
+	readBits(reader, 8);
+	return tag;
+}
+
+Tree* reconstructTree(Arena* arena, BitReader* reader)
+{
+	Tree* tree = createEmptyTree(arena);
+	tree -> root = reconstructNode(reader, tree, 0);
+	if(tree -> root == -1)
+	{
+		return NULL;
+	}
+	return tree;
+}
+
+int reconstructNode(BitReader* reader, Tree* tree, int depth)
+{
+	// A valid header never has more nodes than a tree of every character, nor a code longer than the decoder reads
+	if(tree -> nodeCount == MAX_NODE_COUNT || depth > MAX_CODE_LENGTH || reader -> overrun > 8)
+	{
+		return -1;
+	}
+	if(readBits(reader, 1) == 1)
+	{
+		if(readBits(reader, 1) == 0)
+		{
+			int character = readBits(reader, 8);
+			return addNode(tree, character, 0, -1, -1);
+		}
+		else
+		{
+			readBits(reader, 8);
+			return addNode(tree, PSEUDO_EOF_VALUE, 0, -1, -1);
+		}
+	}
+	else
+	{
+		// Reserve the parent first, children follow it in the array
+		int node = addNode(tree, 'X', 0, -1, -1);
+		int leftChild = reconstructNode(reader, tree, depth + 1);
+		int rightChild = leftChild == -1 ? -1 : reconstructNode(reader, tree, depth + 1);
+		if(rightChild == -1)
+		{
+			return -1;
+		}
+		tree -> nodes[node].leftChild = leftChild;
+		tree -> nodes[node].rightChild = rightChild;
+		return node;
+	}
+}
+
+DecodeTable* buildDecodeTable(Arena* arena, Code* codeTable)
+{
+	// Combine short codes into two-character entries
+	DecodeTable* table = createDecodeTable(arena, codeTable);
+	if(table -> maxLength > 0)
+	{
+		pairDecodeEntries(arena, table);
+	}
+	return table;
+}
+
+DecodeTable* createDecodeTable(Arena* arena, Code* codeTable)
+{
+	return createDecodeTableOfWidth(arena, codeTable, DECODE_TABLE_BITS);
+}
+
+DecodeTable* createDecodeTableOfWidth(Arena* arena, Code* codeTable, int width)
+{
+	DecodeTable* table = arenaAlloc(arena, sizeof(*table));
+	table -> size = 1 << width;
+	table -> capacity = table -> size * 2;
+	table -> entries = arenaAlloc(arena, table -> capacity * sizeof(*table -> entries));
+	memset(table -> entries, 0, table -> capacity * sizeof(*table -> entries));
+	table -> maxLength = 0;
+
+	int i;
+	for(i = 0; i < ASCII_COUNT; i++)
+	{
+		if(codeTable[i].length > table -> maxLength)
+		{
+			table -> maxLength = codeTable[i].length;
+		}
+	}
+
+	// Fill primary table and sub-tables
+	if(table -> maxLength > 0)
+	{
+		fillDecodeTable(arena, table, 0, width, 0, 0, codeTable);
+	}
+	return table;
+}
+
+int fillDecodeTable(Arena* arena, DecodeTable* table, uint32_t offset, int width, int consumed, uint64_t prefix, Code* codeTable)
+{
+	// Longest remainder of a code past this table, for each entry
+	int remainders[1 << DECODE_TABLE_BITS] = {0};
+	int i;
+	uint32_t j;
+
+	for(i = 0; i < ASCII_COUNT; i++)
+	{
+		int length = codeTable[i].length;
+
+		// Skip characters whose code does not start with this table's prefix
+		if(length <= consumed || (codeTable[i].bits >> (length - consumed)) != prefix)
+		{
+			continue;
+		}
+		int remaining = length - consumed;
+		uint64_t rest = codeTable[i].bits & (((uint64_t)1 << remaining) - 1);
+
+		// If the code ends within this table, fill every entry that starts with it
+		if(remaining <= width)
+		{
+			uint32_t first = (uint32_t)rest << (width - remaining);
+			for(j = 0; j < ((uint32_t)1 << (width - remaining)); j++)
+			{
+				DecodeEntry* entry = &table -> entries[offset + first + j];
+				entry -> symbol = i;
+				entry -> count = 1;
+				entry -> length = remaining;
+			}
+		}
+		// Otherwise remember how far the code extends past this table
+		else
+		{
+			uint32_t index = (uint32_t)(rest >> (remaining - width));
+			if(remaining - width > remainders[index])
+			{
+				remainders[index] = remaining - width;
+			}
+		}
+	}
+
+	// Create a sub-table for every entry that long codes pass through
+	for(j = 0; j < ((uint32_t)1 << width); j++)
+	{
+		if(remainders[j] == 0)
+		{
+			continue;
+		}
+		int subWidth = remainders[j] < DECODE_TABLE_BITS ? remainders[j] : DECODE_TABLE_BITS;
+		uint32_t subOffset = table -> size;
+		table -> size += 1 << subWidth;
+		if(table -> size > table -> capacity)
+		{
+			uint32_t oldCapacity = table -> capacity;
+			while(table -> size > table -> capacity)
+			{
+				table -> capacity *= 2;
+			}
+			table -> entries = arenaGrow(arena, table -> entries, oldCapacity * sizeof(*table -> entries), table -> capacity * sizeof(*table -> entries));
+			memset(table -> entries + oldCapacity, 0, (table -> capacity - oldCapacity) * sizeof(*table -> entries));
+		}
+
+		DecodeEntry* entry = &table -> entries[offset + j];
+		entry -> next = subOffset;
+		entry -> count = 0;
+		entry -> length = width;
+		entry -> width = subWidth;
+		fillDecodeTable(arena, table, subOffset, subWidth, consumed + width, (prefix << width) | j, codeTable);
+	}
+	return table -> size;
+}
+
+void pairDecodeEntries(Arena* arena, DecodeTable* table)
+{
+	// Work from a copy so every entry is paired with single-character entries only
+	size_t primarySize = (size_t)1 << DECODE_TABLE_BITS;
+	DecodeEntry* single = arenaAlloc(arena, primarySize * sizeof(*single));
+	memcpy(single, table -> entries, primarySize * sizeof(*single));
+
+	uint32_t i;
+	for(i = 0; i < primarySize; i++)
+	{
+		DecodeEntry* entry = &table -> entries[i];
+		if(entry -> count != 1 || entry -> symbol == PSEUDO_EOF_VALUE || entry -> length >= DECODE_TABLE_BITS)
+		{
+			continue;
+		}
+
+		// The bits after the first code index the entry of the following character
+		DecodeEntry* following = &single[(i << entry -> length) & (primarySize - 1)];
+		if(following -> count == 1 && following -> symbol != PSEUDO_EOF_VALUE &&
+			entry -> length + following -> length <= DECODE_TABLE_BITS)
+		{
+			entry -> second = following -> symbol;
+			entry -> count = 2;
+			entry -> length += following -> length;
+		}
+	}
+}
+
+int decodeSymbols(BitReader* reader, DecodeTable* table, unsigned char* output, size_t capacity, size_t* position)
+{
+	// A tree of only the Pseudo-EOF character means the original file was empty
+	if(table -> maxLength == 0)
+	{
+		return DECODE_END;
+	}
+
+	// Paired entries may consume a whole primary index, so buffer at least that much
+	int lookahead = table -> maxLength > DECODE_TABLE_BITS ? table -> maxLength : DECODE_TABLE_BITS;
+
+	// Stop while there is still room for a paired entry
+	size_t used = *position;
+	int result = DECODE_FULL;
+	while(used + 2 <= capacity)
+	{
+		// Make sure at least one longest code is buffered
+		if(reader -> count < lookahead)
+		{
+			refillBits(reader);
+			if(reader -> overrun > 8)
+			{
+				result = DECODE_TRUNCATED;
+				break;
+			}
+		}
+
+		// Look up the next bits, following links until characters are resolved
+		DecodeEntry* entry = &table -> entries[reader -> bits >> (64 - DECODE_TABLE_BITS)];
+		while(entry -> count == 0 && entry -> width != 0)
+		{
+			reader -> bits <<= entry -> length;
+			reader -> count -= entry -> length;
+			entry = &table -> entries[entry -> next + (reader -> bits >> (64 - entry -> width))];
+		}
+		if(entry -> count == 0)
+		{
+			result = DECODE_INVALID;
+			break;
+		}
+		reader -> bits <<= entry -> length;
+		reader -> count -= entry -> length;
+
+		if(entry -> symbol == PSEUDO_EOF_VALUE)
+		{
+			result = DECODE_END;
+			break;
+		}
+		output[used++] = entry -> symbol;
+		if(entry -> count == 2)
+		{
+			output[used++] = entry -> second;
+		}
+	}
+
+	// Codes read from the zeros supplied past the end were never written, the data was cut short
+	if(reader -> count < reader -> overrun * 8)
+	{
+		result = DECODE_TRUNCATED;
+	}
+	*position = used;
+	return result;
+}
+
+int decodeIntoBuffer(BitReader* reader, DecodeTable* table, unsigned char* output, size_t capacity, size_t* position)
+{
+	// Once fewer than two bytes are left, decode one entry at a time so a pair cannot overflow
+	int result = decodeSymbols(reader, table, output, capacity, position);
+	while(result == DECODE_FULL)
+	{
+		unsigned char rest[2];
+		size_t count = 0;
+		result = decodeSymbols(reader, table, rest, sizeof(rest), &count);
+		if(count > capacity - *position)
+		{
+			return result == DECODE_TRUNCATED ? DECODE_TRUNCATED : DECODE_FULL;
+		}
+		memcpy(output + *position, rest, count);
+		*position += count;
+	}
+	return result;
+}
+
+bool decodeInterleaved(DecodeTable* table, const unsigned char* input, uint32_t* streamSizes, unsigned char* output, size_t size)
+{
+	// Every stream decodes its own part of the output, the last part is whatever is left
+	size_t part = (size + INTERLEAVE_STREAMS - 1) / INTERLEAVE_STREAMS;
+	BitReader readers[INTERLEAVE_STREAMS];
+	unsigned char* out[INTERLEAVE_STREAMS];
+	unsigned char* outEnd[INTERLEAVE_STREAMS];
+	int stream;
+	for(stream = 0; stream < INTERLEAVE_STREAMS; stream++)
+	{
+		initMemoryBitReader(&readers[stream], input, streamSizes[stream]);
+		input += streamSizes[stream];
+		size_t start = (size_t)stream * part < size ? (size_t)stream * part : size;
+		out[stream] = output + start;
+		outEnd[stream] = output + (start + part < size ? start + part : size);
+	}
+
+	// A table of only Pseudo-EOF has no codes for characters
+	if(table -> maxLength == 0)
+	{
+		return size == 0;
+	}
+
+	// While every stream has a whole word left to load and room for its characters, refill all
+	// registers and decode as many characters from each as one refill is sure to hold. The four
+	// lookups of a round do not depend on each other, so the processor overlaps them
+	int perRefill = 56 / table -> maxLength;
+	uint64_t bits[INTERLEAVE_STREAMS] = {0};
+	int count[INTERLEAVE_STREAMS] = {0};
+	const unsigned char* in[INTERLEAVE_STREAMS];
+	for(stream = 0; stream < INTERLEAVE_STREAMS; stream++)
+	{
+		in[stream] = readers[stream].buffer;
+	}
+	while(perRefill > 0)
+	{
+		// A refill loads at most seven bytes, so count the rounds every stream has room for up front
+		size_t rounds = SIZE_MAX;
+		for(stream = 0; stream < INTERLEAVE_STREAMS; stream++)
+		{
+			size_t left = readers[stream].buffer + readers[stream].size - in[stream];
+			size_t inputRounds = left >= 8 ? (left - 8) / 7 + 1 : 0;
+			size_t outputRounds = (outEnd[stream] - out[stream]) / perRefill;
+			rounds = inputRounds < rounds ? inputRounds : rounds;
+			rounds = outputRounds < rounds ? outputRounds : rounds;
+		}
+		if(rounds == 0)
+		{
+			break;
+		}
+
+		for(; rounds > 0; rounds--)
+		{
+			for(stream = 0; stream < INTERLEAVE_STREAMS; stream++)
+			{
+				uint64_t word;
+				memcpy(&word, in[stream], sizeof(word));
+				bits[stream] |= __builtin_bswap64(word) >> count[stream];
+				int bytes = (63 - count[stream]) >> 3;
+				in[stream] += bytes;
+				count[stream] += bytes * 8;
+			}
+
+			int i;
+			for(i = 0; i < perRefill; i++)
+			{
+				for(stream = 0; stream < INTERLEAVE_STREAMS; stream++)
+				{
+					DecodeEntry* entry = &table -> entries[bits[stream] >> (64 - DECODE_TABLE_BITS)];
+					while(entry -> count == 0 && entry -> width != 0)
+					{
+						bits[stream] <<= entry -> length;
+						count[stream] -= entry -> length;
+						entry = &table -> entries[entry -> next + (bits[stream] >> (64 - entry -> width))];
+					}
+					if(entry -> count == 0 || entry -> symbol == PSEUDO_EOF_VALUE)
+					{
+						return false;
+					}
+					bits[stream] <<= entry -> length;
+					count[stream] -= entry -> length;
+					*out[stream]++ = entry -> symbol;
+				}
+			}
+		}
+	}
+
+	// Finish each stream on its own, refilling a byte at a time near its end
+	for(stream = 0; stream < INTERLEAVE_STREAMS; stream++)
+	{
+		BitReader* reader = &readers[stream];
+		reader -> bits = bits[stream];
+		reader -> count = count[stream];
+		reader -> position = in[stream] - reader -> buffer;
+		while(out[stream] < outEnd[stream])
+		{
+			if(reader -> count < table -> maxLength)
+			{
+				refillBits(reader);
+			}
+			DecodeEntry* entry = &table -> entries[reader -> bits >> (64 - DECODE_TABLE_BITS)];
+			while(entry -> count == 0 && entry -> width != 0)
+			{
+				reader -> bits <<= entry -> length;
+				reader -> count -= entry -> length;
+				entry = &table -> entries[entry -> next + (reader -> bits >> (64 - entry -> width))];
+			}
+			if(entry -> count == 0 || entry -> symbol == PSEUDO_EOF_VALUE)
+			{
+				return false;
+			}
+			reader -> bits <<= entry -> length;
+			reader -> count -= entry -> length;
+			*out[stream]++ = entry -> symbol;
+		}
+
+		// Codes must not have run into the zero bytes supplied past the end of the stream, which are
+		// the last bits loaded into the register
+		if(reader -> count < reader -> overrun * 8)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+bool decodeAdaptive(AdaptiveModel* model, BitReader* reader, unsigned char* output, size_t size)
+{
+	size_t i = 0;
+	while(i < size)
+	{
+		// Rebuild codes and table at the same character as the encoder
+		if(model -> seen == model -> nextRebuild)
+		{
+			rebuildAdaptiveCodes(model);
+			model -> table = createDecodeTable(model -> arena, model -> codes);
+		}
+		DecodeTable* table = model -> table;
+		int lookahead = table -> maxLength > DECODE_TABLE_BITS ? table -> maxLength : DECODE_TABLE_BITS;
+
+		// Decode one character at a time up to the next rebuild, counting each
+		size_t end = size - i < model -> nextRebuild - model -> seen ? size : i + (model -> nextRebuild - model -> seen);
+		model -> seen += end - i;
+		for(; i < end; i++)
+		{
+			if(reader -> count < lookahead)
+			{
+				refillBits(reader);
+				if(reader -> overrun > 8)
+				{
+					return false;
+				}
+			}
+			DecodeEntry* entry = &table -> entries[reader -> bits >> (64 - DECODE_TABLE_BITS)];
+			while(entry -> count == 0 && entry -> width != 0)
+			{
+				reader -> bits <<= entry -> length;
+				reader -> count -= entry -> length;
+				entry = &table -> entries[entry -> next + (reader -> bits >> (64 - entry -> width))];
+			}
+			if(entry -> count == 0)
+			{
+				return false;
+			}
+			reader -> bits <<= entry -> length;
+			reader -> count -= entry -> length;
+			output[i] = entry -> symbol;
+			model -> frequencies[entry -> symbol]++;
+		}
+	}
+	return true;
+}
+
+unsigned char* decodeBlock(Arena* arena, int fd, BlockEntry* block, DecodeTable* table, uint32_t number, char* filename)
+{
+	// Read the whole compressed block
+	unsigned char* input = arenaAlloc(arena, block -> compressedSize);
+	STATS_ADD(STATS_READ_CALLS, 1);
+	if(pread(fd, input, block -> compressedSize, block -> compressedOffset) != (ssize_t)block -> compressedSize)
+	{
+		fprintf(stderr, "ERROR: Block %u of %s cannot be read.\n", number, filename);
+		return NULL;
+	}
+	BitReader* reader = createMemoryBitReader(arena, input, block -> compressedSize);
+
+	// Stored and runs blocks need no table, only the expected size
+	unsigned char* output;
+	if(table == NULL && isRawBlock(reader))
+	{
+		output = arenaAlloc(arena, block -> originalSize);
+		if(!decodeRawBlock(reader, output, block -> originalSize))
+		{
+			fprintf(stderr, "ERROR: Block %u of %s has the wrong size.\n", number, filename);
+			return NULL;
+		}
+		return output;
+	}
+
+	// Blocks without a shared table start with their own code lengths
+	if(table == NULL)
+	{
+		Code codeTable[ASCII_COUNT];
+		if(!readCodeLengths(reader, codeTable))
+		{
+			fprintf(stderr, "ERROR: Block %u of %s has an invalid header.\n", number, filename);
+			return NULL;
+		}
+		assignCanonicalCodes(codeTable);
+		table = buildDecodeTable(arena, codeTable);
+	}
+
+	// Room for one paired entry past the expected size, so a longer block is caught
+	size_t capacity = (size_t)block -> originalSize + 2;
+	output = arenaAlloc(arena, capacity);
+	size_t length = 0;
+	int result = decodeSymbols(reader, table, output, capacity, &length);
+	if(result == DECODE_INVALID)
+	{
+		fprintf(stderr, "ERROR: Block %u of %s contains an invalid code.\n", number, filename);
+		return NULL;
+	}
+	if(result != DECODE_END || length != block -> originalSize)
+	{
+		fprintf(stderr, "ERROR: Block %u of %s has the wrong size.\n", number, filename);
+		return NULL;
+	}
+	return output;
+}
+
+bool isRawBlock(BitReader* reader)
+{
+	return peekBits(reader, 3) == BLOCK_RAW_MARK;
+}
+
+bool decodeRawBlock(BitReader* reader, unsigned char* output, size_t size)
+{
+	unsigned char kind;
+	if(readBytes(reader, &kind, 1) != 1)
+	{
+		return false;
+	}
+
+	// Stored contents are copied as they are
+	if(kind == BLOCK_STORED)
+	{
+		return readBytes(reader, output, size) == size;
+	}
+	if(kind != BLOCK_RUNS)
+	{
+		return false;
+	}
+
+	// Runs must add up to exactly the block's size
+	size_t position = 0;
+	while(position < size)
+	{
+		unsigned char run[RUN_SIZE];
+		if(readBytes(reader, run, RUN_SIZE) != RUN_SIZE)
+		{
+			return false;
+		}
+		uint32_t length = readUint32(run + 1);
+		if(length > size - position)
+		{
+			return false;
+		}
+		memset(output + position, run[0], length);
+		position += length;
+	}
+	return true;
+}
+
+BlockIndex* readBlockIndex(Arena* arena, FILE* fp, uint64_t firstOffset)
+{
+	// Footer at the end of the file gives the block size and count
+	int fd = fileno(fp);
+	struct stat status;
+	unsigned char footer[BLOCK_FOOTER_SIZE];
+	if(fstat(fd, &status) != 0 || (uint64_t)status.st_size < firstOffset + BLOCK_FOOTER_SIZE ||
+		pread(fd, footer, BLOCK_FOOTER_SIZE, status.st_size - BLOCK_FOOTER_SIZE) != BLOCK_FOOTER_SIZE)
+	{
+		return NULL;
+	}
+	BlockIndex* index = arenaAlloc(arena, sizeof(*index));
+	index -> blockSize = readUint32(footer);
+	index -> blockCount = readUint32(footer + 4);
+
+	// Index entries sit right before the footer
+	uint64_t indexSize = (uint64_t)index -> blockCount * BLOCK_INDEX_ENTRY_SIZE;
+	if(firstOffset + indexSize + BLOCK_FOOTER_SIZE > (uint64_t)status.st_size)
+	{
+		return NULL;
+	}
+	uint64_t indexOffset = status.st_size - BLOCK_FOOTER_SIZE - indexSize;
+	unsigned char* entries = arenaAlloc(arena, indexSize + 1);
+	if(pread(fd, entries, indexSize, indexOffset) != (ssize_t)indexSize)
+	{
+		return NULL;
+	}
+
+	// Sum sizes into the offset of every block, which must end where the index starts
+	index -> blocks = arenaAlloc(arena, sizeof(*index -> blocks) * (index -> blockCount + 1));
+	uint64_t compressedOffset = firstOffset;
+	uint64_t originalOffset = 0;
+	uint32_t i;
+	for(i = 0; i < index -> blockCount; i++)
+	{
+		BlockEntry* block = &index -> blocks[i];
+		block -> compressedOffset = compressedOffset;
+		block -> originalOffset = originalOffset;
+		block -> compressedSize = readUint32(entries + i * BLOCK_INDEX_ENTRY_SIZE);
+		block -> originalSize = readUint32(entries + i * BLOCK_INDEX_ENTRY_SIZE + 4);
+		compressedOffset += block -> compressedSize;
+		originalOffset += block -> originalSize;
+	}
+	if(compressedOffset != indexOffset)
+	{
+		return NULL;
+	}
+	index -> originalSize = originalOffset;
+	return index;
+}
@@ -0,0 +1,349 @@
+#include "huff.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+// Appends the packed code of character 'k' of the group to the accumulator
+#define EMIT_CODE(k) \
+	{ \
+		uint32_t packed = packedCodes[data[i + (k)]]; \
+		int length = packed & BULK_LENGTH_MASK; \
+		bits = (bits << length) | (packed >> BULK_LENGTH_BITS); \
+		count += length; \
+	}
+
+// Stores the whole bytes of the accumulator, most significant first, and keeps the rest
+#define STORE_BYTES() \
+	{ \
+		uint64_t word = __builtin_bswap64(bits << (64 - count)); \
+		memcpy(out, &word, sizeof(word)); \
+		out += count >> 3; \
+		count &= 7; \
+	}
+
+void encodeData(BitWriter* writer, Code* codeTable, const unsigned char* data, size_t size)
+{
+#ifdef HUFF_BULK_ENCODE
+	encodeDataBulk(writer, codeTable, data, size);
+#else
+	encodeDataScalar(writer, codeTable, data, size);
+#endif
+}
+
+void encodeDataScalar(BitWriter* writer, Code* codeTable, const unsigned char* data, size_t size)
+{
+	// Look up each character's code directly
+	size_t i;
+	for(i = 0; i < size; i++)
+	{
+		writeBits(writer, codeTable[data[i]].bits, codeTable[data[i]].length);
+	}
+}
+
+void encodeDataBulk(BitWriter* writer, Code* codeTable, const unsigned char* data, size_t size)
+{
+	if(size < BULK_MIN_SIZE || writer -> capacity < BULK_MIN_SIZE)
+	{
+		encodeDataScalar(writer, codeTable, data, size);
+		return;
+	}
+
+	// Groups must fit the accumulator next to the seven bits a store can leave behind
+	int maxLength = getMaxCodeLength(codeTable);
+	int group = maxLength <= 14 ? 4 : maxLength <= 19 ? 3 : 2;
+	if(maxLength > BULK_MAX_LENGTH)
+	{
+		encodeDataScalar(writer, codeTable, data, size);
+		return;
+	}
+
+	// Code and length of every character packed into one word
+	uint32_t packedCodes[256];
+	int i;
+	for(i = 0; i < 256; i++)
+	{
+		packedCodes[i] = ((uint32_t)codeTable[i].bits << BULK_LENGTH_BITS) | codeTable[i].length;
+	}
+
+	size_t position = 0;
+	while(position < size)
+	{
+		position = encodeGroups(writer, packedCodes, group, data, position, size);
+
+		// The last characters, and those that reach the end of a buffer until it is written to file,
+		// go one at a time
+		while(position < size && (size - position < (size_t)group || writer -> position + 4 + BULK_SLACK > writer -> capacity))
+		{
+			writeBits(writer, codeTable[data[position]].bits, codeTable[data[position]].length);
+			position++;
+		}
+	}
+}
+
+size_t encodeGroups(BitWriter* writer, uint32_t* packedCodes, int group, const unsigned char* data, size_t position, size_t size)
+{
+	// Move whole bytes out of the register so fewer than eight bits are pending
+	uint64_t bits = writer -> bits;
+	int count = writer -> count;
+	while(count >= 8)
+	{
+		count -= 8;
+		writer -> buffer[writer -> position++] = (unsigned char)(bits >> count);
+	}
+
+	// Every group of characters is merged into the accumulator and its whole bytes stored with one
+	// unaligned write, leaving room for that write at the end of the buffer
+	unsigned char* out = writer -> buffer + writer -> position;
+	unsigned char* limit = writer -> buffer + writer -> capacity - BULK_SLACK;
+	size_t i = position;
+	if(group == 4)
+	{
+		for(; i + 4 <= size && out <= limit; i += 4)
+		{
+			EMIT_CODE(0) EMIT_CODE(1) EMIT_CODE(2) EMIT_CODE(3)
+			STORE_BYTES()
+		}
+	}
+	else if(group == 3)
+	{
+		for(; i + 3 <= size && out <= limit; i += 3)
+		{
+			EMIT_CODE(0) EMIT_CODE(1) EMIT_CODE(2)
+			STORE_BYTES()
+		}
+	}
+	else
+	{
+		for(; i + 2 <= size && out <= limit; i += 2)
+		{
+			EMIT_CODE(0) EMIT_CODE(1)
+			STORE_BYTES()
+		}
+	}
+
+	// Give the writer back whole words only, the bytes past the last one return to the register
+	writer -> position = out - writer -> buffer;
+	int extra = writer -> position % 4;
+	bits &= ((uint64_t)1 << count) - 1;
+	int j;
+	for(j = 0; j < extra; j++)
+	{
+		bits |= (uint64_t)writer -> buffer[writer -> position - extra + j] << (count + 8 * (extra - 1 - j));
+	}
+	writer -> position -= extra;
+	writer -> bits = bits;
+	writer -> count = count + 8 * extra;
+	return i;
+}
+
+void compressBlock(void* argument)
+{
+	BlockJob* job = argument;
+
+	// Count the block's characters and build canonical codes for it alone
+	unsigned long* frequencies = arenaAlloc(job -> arena, ASCII_COUNT * sizeof(*frequencies));
+	memset(frequencies, 0, ASCII_COUNT * sizeof(*frequencies));
+	countBytes(job -> data, job -> size, frequencies);
+	frequencies[PSEUDO_EOF_VALUE] = PSEUDO_EOF_FREQUENCY;
+	BitWriter* writer = createMemoryBitWriter(job -> arena, getCompressedBound(job -> size, job -> lengthLimit));
+
+	// Blocks Huffman coding cannot shrink, or made of long runs, skip building codes
+	int encoding = chooseEncoding(frequencies, job -> data, job -> size);
+	if(encoding != ENCODING_HUFFMAN)
+	{
+		writeBits(writer, encoding == ENCODING_STORED ? BLOCK_STORED : BLOCK_RUNS, 8);
+		if(encoding == ENCODING_STORED)
+		{
+			writeBytes(writer, job -> data, job -> size);
+		}
+		else
+		{
+			encodeRuns(writer, job -> data, job -> size);
+		}
+		flushBitWriter(writer);
+		job -> output = writer -> buffer;
+		job -> outputSize = writer -> position;
+		return;
+	}
+	Code codeTable[ASCII_COUNT];
+	buildCanonicalCodes(job -> arena, frequencies, job -> lengthLimit, codeTable);
+
+	// Encode code lengths, contents and Pseudo-EOF character into memory
+	writeCodeLengths(writer, codeTable);
+	encodeData(writer, codeTable, job -> data, job -> size);
+	writeBits(writer, codeTable[PSEUDO_EOF_VALUE].bits, codeTable[PSEUDO_EOF_VALUE].length);
+	flushBitWriter(writer);
+
+	// The choice was made on a lower bound, blocks whose codes came out no smaller are stored
+	if(writer -> position >= 1 + job -> size)
+	{
+		rewindBitWriter(writer);
+		writeBits(writer, BLOCK_STORED, 8);
+		writeBytes(writer, job -> data, job -> size);
+		flushBitWriter(writer);
+	}
+
+	job -> output = writer -> buffer;
+	job -> outputSize = writer -> position;
+}
+
+int chooseEncoding(unsigned long* frequencies, const unsigned char* data, size_t size)
+{
+	if(size == 0)
+	{
+		return ENCODING_STORED;
+	}
+
+	// No prefix code beats the entropy or spends less than a bit per character, and the header
+	// costs about a byte for every character that appears
+	double bits = 0;
+	int characterCount = 0;
+	int i;
+	for(i = 0; i < PSEUDO_EOF_VALUE; i++)
+	{
+		if(frequencies[i] != 0)
+		{
+			bits -= frequencies[i] * log2((double)frequencies[i] / size);
+			characterCount++;
+		}
+	}
+	if(bits < size)
+	{
+		bits = size;
+	}
+	double bound = bits / 8 + characterCount;
+	if(bound >= size)
+	{
+		return ENCODING_STORED;
+	}
+
+	// Count runs only until they would take more room than Huffman codes could
+	size_t runLimit = (size_t)(bound / RUN_SIZE);
+	size_t runCount = 1;
+	size_t j;
+	for(j = 1; j < size && runCount < runLimit; j++)
+	{
+		runCount += (data[j] != data[j - 1]);
+	}
+	return runCount < runLimit ? ENCODING_RUNS : ENCODING_HUFFMAN;
+}
+
+uint64_t getCanonicalSize(Arena* arena, Code* codeTable, unsigned long* frequencies)
+{
+	// Tag and code lengths, measured by writing them, then every code and Pseudo-EOF
+	BitWriter* header = createMemoryBitWriter(arena, CODE_LENGTHS_BOUND);
+	writeCodeLengths(header, codeTable);
+	uint64_t bits = 8 + 8 * header -> position + header -> count + codeTable[PSEUDO_EOF_VALUE].length;
+	int i;
+	for(i = 0; i < PSEUDO_EOF_VALUE; i++)
+	{
+		bits += (uint64_t)frequencies[i] * codeTable[i].length;
+	}
+	return (bits + 7) / 8;
+}
+
+uint64_t getInterleavedSize(Arena* arena, Code* codeTable, unsigned long* frequencies, size_t size)
+{
+	// Tag and padded code lengths, measured by writing them
+	BitWriter* header = createMemoryBitWriter(arena, CODE_LENGTHS_BOUND);
+	writeCodeLengths(header, codeTable);
+	flushBitWriter(header);
+
+	// Every chunk adds its header and up to a byte of padding per stream, the end adds one more header
+	uint64_t chunkCount = (size + INTERLEAVE_CHUNK_SIZE - 1) / INTERLEAVE_CHUNK_SIZE;
+	uint64_t bits = 0;
+	int i;
+	for(i = 0; i < PSEUDO_EOF_VALUE; i++)
+	{
+		bits += (uint64_t)frequencies[i] * codeTable[i].length;
+	}
+	return 1 + header -> position + chunkCount * (INTERLEAVE_HEADER_SIZE + INTERLEAVE_STREAMS) + INTERLEAVE_HEADER_SIZE + (bits + 7) / 8;
+}
+
+uint64_t getSyncedSize(Arena* arena, Code* codeTable, unsigned long* frequencies, size_t size, size_t interval)
+{
+	// Tag and padded code lengths, measured by writing them
+	BitWriter* header = createMemoryBitWriter(arena, CODE_LENGTHS_BOUND);
+	writeCodeLengths(header, codeTable);
+	flushBitWriter(header);
+
+	// Every segment adds Pseudo-EOF, up to a byte of padding and its index entry, the end adds the footer
+	uint64_t segmentCount = (size + interval - 1) / interval;
+	uint64_t bits = 0;
+	int i;
+	for(i = 0; i < PSEUDO_EOF_VALUE; i++)
+	{
+		bits += (uint64_t)frequencies[i] * codeTable[i].length;
+	}
+	uint64_t segmentBytes = (codeTable[PSEUDO_EOF_VALUE].length + 7) / 8 + 1 + BLOCK_INDEX_ENTRY_SIZE;
+	return 1 + header -> position + segmentCount * segmentBytes + BLOCK_FOOTER_SIZE + (bits + 7) / 8;
+}
+
+void encodeInterleaved(BitWriter* writer, BitWriter** streams, Code* codeTable, const unsigned char* data, size_t size)
+{
+	// Every stream codes an equal part, the last one what is left, and is padded on its own
+	unsigned char header[INTERLEAVE_HEADER_SIZE];
+	writeUint32(header, size);
+	size_t part = (size + INTERLEAVE_STREAMS - 1) / INTERLEAVE_STREAMS;
+	int stream;
+	for(stream = 0; stream < INTERLEAVE_STREAMS; stream++)
+	{
+		size_t start = (size_t)stream * part < size ? (size_t)stream * part : size;
+		size_t end = start + part < size ? start + part : size;
+		streams[stream] -> position = 0;
+		encodeData(streams[stream], codeTable, data + start, end - start);
+		flushBitWriter(streams[stream]);
+		writeUint32(header + 4 + 4 * stream, streams[stream] -> position);
+	}
+
+	writeBytes(writer, header, INTERLEAVE_HEADER_SIZE);
+	for(stream = 0; stream < INTERLEAVE_STREAMS; stream++)
+	{
+		writeBytes(writer, streams[stream] -> buffer, streams[stream] -> position);
+	}
+}
+
+void encodeRuns(BitWriter* writer, const unsigned char* data, size_t size)
+{
+	// Every run is the character and its length, runs longer than 32 bits can count are split
+	size_t i = 0;
+	while(i < size)
+	{
+		size_t start = i;
+		while(i < size && data[i] == data[start] && i - start < UINT32_MAX)
+		{
+			i++;
+		}
+		writeBits(writer, data[start], 8);
+		writeBits(writer, i - start, 32);
+	}
+}
+
+void encodeHeader(BitWriter* writer, Tree* tree, int node)
+{
+	Node* current = &tree -> nodes[node];
+
+	// If leaf node
+	if((current -> leftChild == -1) && (current -> rightChild == -1))
+	{
+		// Write a one, then the binary representation of the character
+		writeBits(writer, 1, 1);
+		if(current -> value == PSEUDO_EOF_VALUE)
+		{
+			writeBits(writer, 0x100, 9);
+		}
+		else
+		{
+			// A zero followed by the eight bits of the character
+			writeBits(writer, current -> value, 9);
+		}
+	}
+	else
+	{
+		// Write a zero and recurse
+		writeBits(writer, 0, 1);
+		encodeHeader(writer, tree, current -> leftChild);
+		encodeHeader(writer, tree, current -> rightChild);
+	}	
+}
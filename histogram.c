@@ -0,0 +1,54 @@
+#include "huff.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void countBytes(const unsigned char* data, size_t size, unsigned long* frequencies)
+{
+	// Count in chunks small enough that 32-bit sub-table counters cannot overflow
+	uint32_t counts[HISTOGRAM_TABLES][256];
+	while(size > 0)
+	{
+		size_t chunk = size < HISTOGRAM_CHUNK_SIZE ? size : HISTOGRAM_CHUNK_SIZE;
+		memset(counts, 0, sizeof(counts));
+		countIntoTables(data, chunk, counts);
+
+		// Combine sub-tables into the frequency of every character
+		int i;
+		int j;
+		for(i = 0; i < 256; i++)
+		{
+			for(j = 0; j < HISTOGRAM_TABLES; j++)
+			{
+				frequencies[i] += counts[j][i];
+			}
+		}
+		data += chunk;
+		size -= chunk;
+	}
+}
+
+void countIntoTables(const unsigned char* data, size_t size, uint32_t (*counts)[256])
+{
+	// Consecutive bytes go to different sub-tables, so repeated bytes do not wait on each other
+	size_t i = 0;
+	for(; i + 8 <= size; i += 8)
+	{
+		uint64_t word;
+		memcpy(&word, data + i, sizeof(word));
+		counts[0][word & 0xFF]++;
+		counts[1][(word >> 8) & 0xFF]++;
+		counts[2][(word >> 16) & 0xFF]++;
+		counts[3][(word >> 24) & 0xFF]++;
+		counts[0][(word >> 32) & 0xFF]++;
+		counts[1][(word >> 40) & 0xFF]++;
+		counts[2][(word >> 48) & 0xFF]++;
+		counts[3][word >> 56]++;
+	}
+
+	// Count remaining bytes one by one
+	for(; i < size; i++)
+	{
+		counts[0][data[i]]++;
+	}
+}
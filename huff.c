@@ -6,625 +6,757 @@
 
 int main(int argc, char* argv[])
 {
-	// Error handling
-	if(argc == 1)
+	// Read options, every other argument is a file to compress
+	CompressOptions options;
+	options.canonical = false;
+	options.adaptive = false;
+	options.context = false;
+	options.interleaved = false;
+	options.blockMode = false;
+	options.memoryUsage = false;
+	options.lengthLimit = DEFAULT_CODE_LENGTH_LIMIT;
+	options.threadCount = getProcessorCount();
+	options.blockSize = DEFAULT_BLOCK_SIZE;
+	options.syncInterval = 0;
+	options.model = NULL;
+	options.direct = false;
+	int jobCount = getProcessorCount();
+	char* trainFilename = NULL;
+	char* modelFilename = NULL;
+	char* listFilename = NULL;
+	char** files = malloc(sizeof(*files) * argc);
+	int fileCount = 0;
+	int i;
+	for(i = 1; i < argc; i++)
 	{
-		printf("Must pass in a filename to compress.\n");
-		return EXIT_FAILURE;
+		if(strcmp(argv[i], "-c") == 0 || strcmp(argv[i], "--canonical") == 0)
+		{
+			options.canonical = true;
+		}
+		else if(strcmp(argv[i], "-a") == 0 || strcmp(argv[i], "--adaptive") == 0)
+		{
+			options.adaptive = true;
+		}
+		else if(strcmp(argv[i], "-o") == 0 || strcmp(argv[i], "--context") == 0)
+		{
+			options.context = true;
+		}
+		else if(strcmp(argv[i], "-i") == 0 || strcmp(argv[i], "--interleaved") == 0)
+		{
+			// Streams share the code lengths in the header
+			options.canonical = true;
+			options.interleaved = true;
+		}
+		else if(strcmp(argv[i], "-m") == 0 || strcmp(argv[i], "--memory") == 0)
+		{
+			options.memoryUsage = true;
+		}
+		else if((strcmp(argv[i], "-l") == 0 || strcmp(argv[i], "--max-length") == 0) && i + 1 < argc)
+		{
+			options.lengthLimit = atoi(argv[++i]);
+			if(options.lengthLimit < MIN_CODE_LENGTH_LIMIT || options.lengthLimit > MAX_CODE_LENGTH)
+			{
+				fprintf(stderr, "Code length limit must be between %d and %d.\n", MIN_CODE_LENGTH_LIMIT, MAX_CODE_LENGTH);
+				return EXIT_FAILURE;
+			}
+		}
+		else if((strcmp(argv[i], "-t") == 0 || strcmp(argv[i], "--threads") == 0) && i + 1 < argc)
+		{
+			options.blockMode = true;
+			options.threadCount = atoi(argv[++i]);
+			if(options.threadCount < 1)
+			{
+				fprintf(stderr, "Thread count must be at least 1.\n");
+				return EXIT_FAILURE;
+			}
+		}
+		else if((strcmp(argv[i], "-j") == 0 || strcmp(argv[i], "--jobs") == 0) && i + 1 < argc)
+		{
+			jobCount = atoi(argv[++i]);
+			if(jobCount < 1)
+			{
+				fprintf(stderr, "Job count must be at least 1.\n");
+				return EXIT_FAILURE;
+			}
+		}
+		else if((strcmp(argv[i], "-b") == 0 || strcmp(argv[i], "--block-size") == 0) && i + 1 < argc)
+		{
+			options.blockMode = true;
+			options.blockSize = (size_t)atol(argv[++i]) << 10;
+			if(options.blockSize == 0 || options.blockSize > MAX_BLOCK_SIZE)
+			{
+				fprintf(stderr, "Block size must be between 1 and %d KiB.\n", MAX_BLOCK_SIZE >> 10);
+				return EXIT_FAILURE;
+			}
+		}
+		else if((strcmp(argv[i], "-s") == 0 || strcmp(argv[i], "--sync") == 0) && i + 1 < argc)
+		{
+			// Sync points need code lengths in the header
+			options.canonical = true;
+			options.syncInterval = (size_t)atol(argv[++i]) << 10;
+			if(options.syncInterval == 0 || options.syncInterval > MAX_BLOCK_SIZE)
+			{
+				fprintf(stderr, "Sync interval must be between 1 and %d KiB.\n", MAX_BLOCK_SIZE >> 10);
+				return EXIT_FAILURE;
+			}
+		}
+		else if(strcmp(argv[i], "--train") == 0 && i + 1 < argc)
+		{
+			trainFilename = argv[++i];
+		}
+		else if((strcmp(argv[i], "-M") == 0 || strcmp(argv[i], "--model") == 0) && i + 1 < argc)
+		{
+			modelFilename = argv[++i];
+		}
+		else if((strcmp(argv[i], "-L") == 0 || strcmp(argv[i], "--list") == 0) && i + 1 < argc)
+		{
+			listFilename = argv[++i];
+		}
+		else if(strcmp(argv[i], "--direct") == 0)
+		{
+			options.direct = true;
+		}
+		else if(strcmp(argv[i], "--stats") == 0)
+		{
+			enableStats();
+		}
+		else
+		{
+			files[fileCount++] = argv[i];
+		}
 	}
-	char* filename = argv[1];
-
-	// Get a sorted, doubly-linked list of frequencies of the characters that appear in the file
-	unsigned long* asciiFrequencies = getFrequency(filename);
-	List* characterFrequencies = frequencySort(asciiFrequencies);
-
-	// Create the Huffman tree from frequency list
-	createTree(characterFrequencies);
-
-	// Write header and contents to file using Huffman tree
-	List* encodingList = getBitEncodings(characterFrequencies -> head);
-	writeCompressed(filename, encodingList, characterFrequencies -> head);
 
-	// Free all allocated memory
-	free(asciiFrequencies);
-	freeList(encodingList);
-	freeTree(characterFrequencies);
-	return EXIT_SUCCESS;
-}
+	// Error handling
+	if(fileCount == 0 && listFilename == NULL)
+	{
+		fprintf(stderr, "Usage: huff [-c | --canonical] [-a | --adaptive] [-o | --context] [-i | --interleaved]\n");
+		fprintf(stderr, "            [-l | --max-length bits] [-m | --memory] [-t | --threads count]\n");
+		fprintf(stderr, "            [-b | --block-size KiB] [-s | --sync KiB] [-M | --model file]\n");
+		fprintf(stderr, "            [-j | --jobs count] [-L | --list file] [--direct] [--stats]\n");
+		fprintf(stderr, "            filename... | directory... | -\n");
+		fprintf(stderr, "       huff --train model [-l | --max-length bits] sample...\n");
+		free(files);
+		return EXIT_FAILURE;
+	}
+	Arena* arena = createArena(ARENA_BLOCK_SIZE);
+	bool success;
 
-unsigned long* getFrequency(char* filename)
-{
-	// Open file, error handle
-	FILE* fp = fopen(filename, "r");
-	if(fp == NULL)
+	// Training counts every sample together and writes only the model
+	if(trainFilename != NULL)
 	{
-		printf("ERROR: File pointer is null.");
-		return NULL;
+		success = writeTrainedModel(arena, trainFilename, files, fileCount, options.lengthLimit);
 	}
 
-	unsigned long* frequencies = calloc(ASCII_COUNT, sizeof(*frequencies));
-	int character = 0;
-	while((character = fgetc(fp)) != EOF)
+	// A filename of - compresses standard input to standard output, a block at a time
+	else if(fileCount == 1 && listFilename == NULL && strcmp(files[0], "-") == 0)
 	{
-		frequencies[character]++;
+		OutputFile* out = createOutput(arena, STDOUT_FILENO, "standard output");
+		if(out == NULL)
+		{
+			free(files);
+			freeArena(arena);
+			return EXIT_FAILURE;
+		}
+		success = options.adaptive ? writeAdaptive(arena, stdin, out, options.blockSize, options.lengthLimit) :
+			writeStream(arena, stdin, out, options.blockSize, options.threadCount, options.lengthLimit);
+		success = closeOutput(out) && success;
 	}
-	// Add pseudo-eof character
-	frequencies[PSEUDO_EOF_VALUE] = PSEUDO_EOF_FREQUENCY;
-	
-	//free(fileContents);
-	fclose(fp);
-	return frequencies;
+	else
+	{
+		// The model is read once and shared by every file
+		success = true;
+		if(modelFilename != NULL)
+		{
+			options.model = loadModel(arena, modelFilename);
+			success = (options.model != NULL);
+		}
+
+		// Several files, directories or a list are compressed concurrently, each worker reusing its memory
+		int batchCount = 0;
+		char** batch = success ? collectFiles(arena, files, fileCount, listFilename, "../Compressed Output/", &batchCount) : NULL;
+		if(batch == NULL)
+		{
+			success = false;
+		}
+		else if(batchCount == 1 && fileCount == 1 && listFilename == NULL && batch[0] == files[0])
+		{
+			success = compressFile(arena, files[0], &options);
+		}
+		else
+		{
+			success = runBatch(batch, batchCount, jobCount, compressFile, &options);
+		}
+	}
+
+	printStats(stderr);
+	free(files);
+	freeArena(arena);
+	return success ? EXIT_SUCCESS : EXIT_FAILURE;
 }
 
-List* frequencySort(unsigned long* asciiFrequencies)
+bool compressFile(Arena* arena, char* filename, void* options)
 {
-	// Creates an array of ascii characters (asciiCharacters[65] = 65 or 'A')
-	int asciiCharacters[ASCII_COUNT] = {0};
-	int i;
-	for(i = 0; i < ASCII_COUNT; i++)
-	{
-		asciiCharacters[i] = i;
-	}
+	CompressOptions* settings = options;
+	STATS_START(timer);
 
-	// Bubblesort ASCII characters by frequency
-	int j;
-	for (i = 0; i < ASCII_COUNT - 1; i++)
+	// Adaptive coding reads the file once, as messages of one block each
+	if(settings -> adaptive)
 	{
-		for(j = 0; j < ASCII_COUNT - i - 1; j++)
+		FILE* in = fopen(filename, "rb");
+		OutputFile* compressed = in != NULL ? openCompressed(arena, filename, settings -> direct) : NULL;
+		STATS_STAGE(timer, STATS_INPUT);
+		bool success = compressed != NULL && writeAdaptive(arena, in, compressed, settings -> blockSize, settings -> lengthLimit);
+		if(in == NULL)
 		{
-			if(asciiFrequencies[j] > asciiFrequencies[j + 1])
-			{
-				swapFrequencies(&asciiFrequencies[j], &asciiFrequencies[j + 1]);
-				swapCharacters(&asciiCharacters[j], &asciiCharacters[j + 1]);
-			}
+			fprintf(stderr, "Cannot open %s\n", filename);
+		}
+		if(compressed != NULL)
+		{
+			STATS_STAGE(timer, STATS_ENCODE);
+			STATS_ADD(STATS_BYTES_IN, ftell(in));
+			STATS_ADD(STATS_SYMBOLS, ftell(in));
+			STATS_ADD(STATS_BYTES_OUT, getOutputOffset(compressed));
+			STATS_ADD(STATS_COMPRESSED_BYTES, getOutputOffset(compressed));
+			success = closeOutput(compressed) && success;
+		}
+		if(in != NULL)
+		{
+			fclose(in);
 		}
+		if(settings -> memoryUsage)
+		{
+			printArenaUsage(arena, filename);
+		}
+		return success;
 	}
 
-	// Trim characters and their frequencies down to only those that exist in the file
-	int usedCharacterCount = 0;
-	for(i = 0; i < ASCII_COUNT; i++)
+	// Open the file to compress and filename.txt.huff
+	InputFile* input = openInput(arena, filename);
+	if(input == NULL)
 	{
-		if(asciiFrequencies[i] != 0)
-		{
-			usedCharacterCount++;
-		}
+		return false;
 	}
-	unsigned long* frequencies = calloc(sizeof(*frequencies), usedCharacterCount);
-	int* characters = calloc(sizeof(*characters), usedCharacterCount);
-	j = 0;
-	for(i = 0; i < ASCII_COUNT; i++)
+	OutputFile* compressed = openCompressed(arena, filename, settings -> direct);
+	if(compressed == NULL)
 	{
-		if(asciiFrequencies[i] != 0)
+		closeInput(input);
+		return false;
+	}
+	STATS_STAGE(timer, STATS_INPUT);
+	STATS_ADD(STATS_BYTES_IN, input -> size);
+	STATS_ADD(STATS_SYMBOLS, input -> size);
+
+	// A trained model replaces counting and building codes for this file, files its codes cannot shrink are stored
+	if(settings -> model != NULL)
+	{
+		STATS_CODE_LENGTHS(settings -> model -> codes);
+		if(!writeWithModel(arena, input, compressed, settings -> model))
 		{
-			frequencies[j] = asciiFrequencies[i];
-			characters[j] = asciiCharacters[i];
-			j++;
+			writeRaw(arena, input, compressed, ENCODING_STORED);
 		}
 	}
 
-	// Creates doubly linked list of characters and their frequencies in ascending order
-	List* frequencyList = createList(); 
-
-	for(i = 0; i < usedCharacterCount; i++)
+	// In block mode every block is modelled and encoded separately on the thread pool
+	else if(settings -> blockMode)
 	{
-		Node* node = createNode(characters[i], frequencies[i]);
-		append(frequencyList, node);
+		writeBlocks(arena, input, compressed, settings -> blockSize, settings -> threadCount, settings -> lengthLimit);
 	}
-
-	free(frequencies);
-	free(characters);
-	return frequencyList;
-}
-
-void createTree(List* frequencyList)
-{
-	// While the list still exists
-	while(frequencyList -> nodeCount != 1)
+	else
 	{
-		// Stop if there is only one node left (All nodes have been paired up into a tree
-		if(frequencyList -> head == frequencyList -> tail)
+		// Get the frequencies of the characters that appear in the file
+		unsigned long* asciiFrequencies = getFrequency(arena, input);
+		STATS_STAGE(timer, STATS_FREQUENCY);
+
+		// Files Huffman coding cannot shrink, or made of long runs, are written without building a tree.
+		// Neither needs sync points, they are read as fast as they can be copied
+		int encoding = chooseEncoding(asciiFrequencies, input -> data, input -> size);
+		if(settings -> context && settings -> syncInterval == 0 && encoding != ENCODING_RUNS)
+		{
+			// Order-1 codes can shrink data whose characters alone look random, so they decide on storing themselves
+			writeContexts(arena, input, compressed, settings -> lengthLimit);
+		}
+		else if(encoding != ENCODING_HUFFMAN)
 		{
-			return;
+			writeRaw(arena, input, compressed, encoding);
 		}
 		else
 		{
-			// Select first two nodes, since list is sorted, should be the two lowest frequencies
-			Node* leftChild = frequencyList -> head;
-			Node* rightChild = frequencyList -> head -> right;
-
-			// Create parent node
-			Node* node = createNode('X', leftChild -> frequency + rightChild -> frequency);
-			node -> leftChild = leftChild;
-			node -> rightChild = rightChild;
+			// Create the Huffman tree from frequencies
+			Tree* huffmanTree = createTree(arena, asciiFrequencies);
+			STATS_STAGE(timer, STATS_TREE);
+			Code codeTable[ASCII_COUNT];
+			getBitEncodings(huffmanTree, codeTable);
+
+			// If the tree is too deep, replace it with one built from length-limited codes
+			if(getMaxCodeLength(codeTable) > settings -> lengthLimit)
+			{
+				limitCodeLengths(arena, asciiFrequencies, codeTable, settings -> lengthLimit);
+				assignCanonicalCodes(codeTable);
+				if(!settings -> canonical)
+				{
+					huffmanTree = createTreeFromCodes(arena, codeTable);
+				}
+			}
 
-			// If this is the last pair of nodes
-			if(rightChild -> right == NULL)
+			// Write header and contents to file using Huffman tree
+			if(settings -> canonical)
+			{
+				assignCanonicalCodes(codeTable);
+			}
+			STATS_STAGE(timer, STATS_CODES);
+			STATS_CODE_LENGTHS(codeTable);
+			if(settings -> syncInterval > 0)
 			{
-				frequencyList -> head = node;
-				frequencyList -> tail = node;
-				leftChild -> left = NULL;
-				leftChild -> right = NULL;
-				rightChild -> left = NULL;
-				rightChild -> right = NULL;
+				// Padding and index entries of small segments can outweigh what coding gains
+				if(getSyncedSize(arena, codeTable, asciiFrequencies, input -> size, settings -> syncInterval) >= 1 + input -> size)
+				{
+					writeRaw(arena, input, compressed, ENCODING_STORED);
+				}
+				else
+				{
+					writeSynced(arena, input, compressed, codeTable, settings -> syncInterval);
+				}
+			}
+			else if(settings -> interleaved)
+			{
+				// Chunk headers can outweigh what small files gain, those are stored like the other modes do
+				if(getInterleavedSize(arena, codeTable, asciiFrequencies, input -> size) >= input -> size)
+				{
+					writeRaw(arena, input, compressed, ENCODING_STORED);
+				}
+				else
+				{
+					writeInterleaved(arena, input, compressed, codeTable);
+				}
+			}
+			else if(settings -> canonical && getCanonicalSize(arena, codeTable, asciiFrequencies) >= 1 + input -> size)
+			{
+				// The choice above was made on a lower bound, codes that would not shrink the file are not used
+				writeRaw(arena, input, compressed, ENCODING_STORED);
 			}
-			// Cut children nodes from list, update list head, insert parent node back into list
 			else
 			{
-				rightChild -> right -> left = NULL;
-				frequencyList -> head = rightChild -> right;
-				leftChild -> left = NULL;
-				leftChild -> right = NULL;
-				rightChild -> left = NULL;
-				rightChild -> right = NULL;
-				insertNode(frequencyList, node);
+				writeCompressed(arena, input, compressed, codeTable, huffmanTree, settings -> canonical);
 			}
 		}
-		// Compensate for removal of two children and addition of one parent
-		frequencyList -> nodeCount--;
 	}
+
+	// Close both files
+	STATS_ADD(STATS_BYTES_OUT, getOutputOffset(compressed));
+	STATS_ADD(STATS_COMPRESSED_BYTES, getOutputOffset(compressed));
+	bool success = closeOutput(compressed);
+	STATS_STAGE(timer, STATS_ENCODE);
+	closeInput(input);
+	if(settings -> memoryUsage)
+	{
+		printArenaUsage(arena, filename);
+	}
+	return success;
+}
+
+unsigned long* getFrequency(Arena* arena, InputFile* input)
+{
+	unsigned long* frequencies = arenaAlloc(arena, ASCII_COUNT * sizeof(*frequencies));
+	memset(frequencies, 0, ASCII_COUNT * sizeof(*frequencies));
+	countBytes(input -> data, input -> size, frequencies);
+
+	// Add pseudo-eof character
+	frequencies[PSEUDO_EOF_VALUE] = PSEUDO_EOF_FREQUENCY;
+	
+	return frequencies;
 }
 
-List* getBitEncodings(Node* encodingTree)
+OutputFile* openCompressed(Arena* arena, char* originalFilename, bool direct)
 {
-	// Create new list and bit code variable, start recursive code generation
-	List* encodingList = createList();
-	int treeDepth = getMaxDepth(encodingTree);
-	char* code = calloc((sizeof(*code) * treeDepth) + 1, 1);
-	getCodes(encodingTree, encodingList, code, 0, treeDepth);
-
-	free(code);
-	return encodingList;
+	// Create filename.txt.huff
+	char* compressedFilename = getOutputPath(arena, "../Compressed Output/", originalFilename, ".huff");
+	return openOutput(arena, compressedFilename, direct);
 }
 
-void getCodes(Node* node, List* list, char* code, int index, int treeDepth)
+void writeCompressed(Arena* arena, InputFile* original, OutputFile* compressed, Code* codeTable, Tree* encodingTree, bool canonical)
 {
-	// If left child is not null, append a zero to bit code and recurse on left child
-	if(node -> leftChild != NULL)
+	BitWriter* writer = createBitWriter(arena, compressed);
+
+	// Write header, either the code lengths behind a format tag or the whole tree
+	if(canonical)
 	{
-		code[index] = '0';
-		getCodes(node -> leftChild, list, code, index + 1, treeDepth);
-		code[index] = '\0';
+		writeBits(writer, FORMAT_CANONICAL, 8);
+		writeCodeLengths(writer, codeTable);
 	}
-	
-	// If right child is not null, append a one to bit code and recurse on right child
-	if(node -> rightChild != NULL)
+	else
 	{
-		code[index] = '1';
-		getCodes(node -> rightChild, list, code, index + 1, treeDepth);
-		code[index] = '\0';
+		encodeHeader(writer, encodingTree, encodingTree -> root);
 	}
 
-	// If node is a leaf node
-	if((node -> leftChild == NULL) && (node -> rightChild == NULL))
-	{
-		// Create a copy of node
-		Node* encodedNode = createNode(node -> value, node -> frequency);
-
-		// Create a copy of the generated code
-		char* bitCode = malloc(((sizeof(*bitCode) * index) + 1));
-		memcpy(bitCode, code, ((sizeof(*bitCode) * index) + 1));
+	// Write contents to file, then Pseudo-EOF character to denote end of contents
+	encodeData(writer, codeTable, original -> data, original -> size);
+	writeBits(writer, codeTable[PSEUDO_EOF_VALUE].bits, codeTable[PSEUDO_EOF_VALUE].length);
 
-		// Combine and add node to encoding list
-		encodedNode -> code = bitCode;
-
-		append(list, encodedNode);
-	}	
+	// Pad the last byte and write what is left
+	flushBitWriter(writer);
 }
 
-void writeCompressed(char* originalFilename, List* encodingList, Node* encodingTree)
+bool writeTrainedModel(Arena* arena, char* modelFilename, char** samples, int sampleCount, int lengthLimit)
 {
-	// Create filename.txt.huff
-	char* compressedFilename = malloc(sizeof("../Compressed Output/") + strlen(originalFilename) + sizeof(".huff"));
-    strcpy(compressedFilename, "../Compressed Output/");
-    strcat(compressedFilename, originalFilename);
-	strcat(compressedFilename, ".huff");
-
-	// Prepare for writing
-	FILE* compressed = fopen(compressedFilename, "wb");
-	FILE* original = fopen(originalFilename, "r");
-
-    compressed == NULL ? printf("Cannot open %s\n", compressedFilename) : 0;
-    original == NULL ? printf("Cannot open %s\n", originalFilename) : 0;
-
-	int byte = 0;
-	int level = 0;
-	int character = 0;
-	Node* node = encodingList -> head;
-
-	// Write header
-	encodeHeader(compressed, encodingTree, &byte, &level);
-
-	// Write contents to file
-	while((character = fgetc(original)) != EOF)
+	// Counts of all samples together, each released once it has been counted
+	unsigned long* frequencies = arenaAlloc(arena, ASCII_COUNT * sizeof(*frequencies));
+	memset(frequencies, 0, ASCII_COUNT * sizeof(*frequencies));
+	int i;
+	for(i = 0; i < sampleCount; i++)
 	{
-		while(node != NULL)
+		InputFile* input = openInput(arena, samples[i]);
+		if(input == NULL)
 		{
-			if(node -> value == character)
-			{
-				writeCode(node -> code, compressed, &byte, &level);
-			}
-			node = node -> right;
+			return false;
 		}
-		node = encodingList -> head;
+		countBytes(input -> data, input -> size, frequencies);
+		closeInput(input);
 	}
 
-	// Write Pseudo-EOF character to denote end of contents
-	while(node -> value != PSEUDO_EOF_VALUE)
+	Model* model = trainModel(arena, frequencies, lengthLimit);
+	unsigned char* data;
+	size_t size = writeModel(arena, model, &data);
+
+	FILE* fp = fopen(modelFilename, "wb");
+	if(fp == NULL)
 	{
-		node = node -> right;
+		fprintf(stderr, "Cannot open %s\n", modelFilename);
+		return false;
 	}
-
-	writeCode(node -> code, compressed, &byte, &level);
-
-	// Pad last byte with zeros if needed
-	if(level > 0)
+	bool success = fwrite(data, 1, size, fp) == size;
+	success = (fclose(fp) == 0) && success;
+	if(!success)
 	{
-		while(level != 0)
-		{
-			writeCode((char*)"0", compressed, &byte, &level);
-		}
+		fprintf(stderr, "ERROR: Cannot write %s\n", modelFilename);
 	}
-
-	// Free and close
-	free(compressedFilename);
-	fclose(original);
-	fclose(compressed);
+	return success;
 }
 
-void encodeHeader(FILE* fp, Node* node, int* byte, int* level)
+bool writeWithModel(Arena* arena, InputFile* original, OutputFile* compressed, Model* model)
 {
-	// If leaf node
-	if((node -> leftChild == NULL) && (node -> rightChild == NULL))
+	// Coded into memory a chunk at a time, given up as soon as storing the file would take no more room
+	int longest = getMaxCodeLength(model -> codes);
+	BitWriter* writer = createMemoryBitWriter(arena, 1 + original -> size + getCompressedBound(MODEL_CHUNK_SIZE, longest));
+
+	// Header is only the identifier, the decoder must be given the same model
+	writeBits(writer, FORMAT_MODEL, 8);
+	writeBits(writer, model -> id, 32);
+
+	size_t offset;
+	for(offset = 0; offset < original -> size; offset += MODEL_CHUNK_SIZE)
 	{
-		// Write a one, then the binary representation of the character
-		writeCode((char*)"1", fp, byte, level);
-		if(node -> value == PSEUDO_EOF_VALUE)
+		size_t size = original -> size - offset < MODEL_CHUNK_SIZE ? original -> size - offset : MODEL_CHUNK_SIZE;
+		encodeData(writer, model -> codes, original -> data + offset, size);
+		if(writer -> position >= 1 + original -> size)
 		{
-			writeCode((char*)"100000000", fp, byte, level);
-		}
-		else
-		{
-			char* binaryRep = getBinary(node);
-			writeCode((char*)"0", fp, byte, level);
-			writeCode(binaryRep, fp, byte, level);
-			free(binaryRep);
+			return false;
 		}
 	}
-	else
+	writeBits(writer, model -> codes[PSEUDO_EOF_VALUE].bits, model -> codes[PSEUDO_EOF_VALUE].length);
+	flushBitWriter(writer);
+	if(writer -> position >= 1 + original -> size)
 	{
-		// Write a zero and recurse
-		writeCode((char*)"0", fp, byte, level);
-		encodeHeader(fp, node -> leftChild, byte, level);
-		encodeHeader(fp, node -> rightChild, byte, level);
-	}	
+		return false;
+	}
+	writeOutput(compressed, writer -> buffer, writer -> position);
+	return true;
 }
 
-char* getBinary(Node* node)
+void writeRaw(Arena* arena, InputFile* original, OutputFile* compressed, int encoding)
 {
-	// Set up
-	char* binary = malloc(sizeof(*binary) * 9);
-	binary[8] = 0;
-	int i;
+	BitWriter* writer = createBitWriter(arena, compressed);
 
-	// Construct bit sequence
-	for(i = 7; i >= 0; i--)
+	// Tag, then the contents as they are or the original size and the runs, both to the end of the file
+	if(encoding == ENCODING_STORED)
 	{
-		binary[7 - i] = ((node -> value >> i) & 1) + 48;
+		writeBits(writer, FORMAT_STORED, 8);
+		writeBytes(writer, original -> data, original -> size);
 	}
-	return binary;
-}
-
-void writeCode(char* code, FILE* fp, int* byte, int* level)
-{
-	char c;
-	for(c = *code++; c != '\0'; c = *code++)
+	else
 	{
-		int bit = c - '0';
-		*byte |= bit << (7 - *level);
-		(*level)++;
-
-		// If buffer is full, write the byte to file
-		if(*level == 8)
-		{
-			fputc(*byte, fp);
-			*level = 0;
-			*byte = 0;
-		}
+		unsigned char header[RUNS_HEADER_SIZE];
+		writeUint64(header, original -> size);
+		writeBits(writer, FORMAT_RUNS, 8);
+		writeBytes(writer, header, RUNS_HEADER_SIZE);
+		encodeRuns(writer, original -> data, original -> size);
 	}
+	flushBitWriter(writer);
 }
 
-void printByte(int byte)
+void writeContexts(Arena* arena, InputFile* original, OutputFile* compressed, int lengthLimit)
 {
-	printf("Byte: ");
-	int i;
-	
-	// Print the bits of the byte
-	for(i = 7; i >= 0; i--)
+	ContextModel* model = buildContextModel(arena, original -> data, original -> size, lengthLimit);
+	if(original -> size == 0 || model -> bits / 8 >= original -> size)
 	{
-		printf("%c", (byte & (1 << i)) ? '1' : '0');
+		writeRaw(arena, original, compressed, ENCODING_STORED);
+		return;
+	}
+	int table;
+	for(table = 0; table < model -> tableCount; table++)
+	{
+		STATS_CODE_LENGTHS(model -> codes[table]);
 	}
-	printf("\n");
-}
-
-
-unsigned long getFileSize(FILE* fp)
-{
-	// Set original position
-	int originalPosition = ftell(fp);
-	
-	// Seek to end, record position
-	fseek(fp, 0L, SEEK_END);
-	long long fileSize = ftell(fp);
-
-	// Seek back to original position
-	fseek(fp, 0L, originalPosition);
-
-	return fileSize;
-}
-
-void swapFrequencies(unsigned long* x, unsigned long* y)
-{
-	unsigned long temp = *x;
-	*x = *y;
-	*y = temp;
-}
-
-void swapCharacters(int* x, int* y)
-{
-	int temp = *x;
-	*x = *y;
-	*y = temp;
-}
-
-List* createList()
-{
-	// Initialize blank list
-	List* list = malloc(sizeof(*list));
-	list -> nodeCount = 0;
-	list -> head = NULL;
-	list -> tail = NULL;
 
-	return list;
+	// Tag and tables, then every character coded in the context of the one before
+	BitWriter* writer = createBitWriter(arena, compressed);
+	writeBits(writer, FORMAT_CONTEXT, 8);
+	writeContextModel(writer, model);
+	encodeContexts(writer, model, original -> data, original -> size);
+	flushBitWriter(writer);
 }
 
-Node* createNode(int value, unsigned long frequency)
+void writeBlocks(Arena* arena, InputFile* original, OutputFile* compressed, size_t blockSize, int threadCount, int lengthLimit)
 {
-	// Initialize node
-	Node* node = malloc(sizeof(*node));
-	node -> value = value;
-	node -> frequency = frequency;
-	node -> left = NULL;
-	node -> right = NULL;
-	node -> leftChild = NULL;
-	node -> rightChild = NULL;
-	node -> code = NULL;
-
-	return node;
-}
+	// Every slot holds one block being compressed, with room for two per thread
+	uint32_t blockCount = (original -> size + blockSize - 1) / blockSize;
+	int slotCount = threadCount * 2;
+	BlockJob* jobs = arenaAlloc(arena, sizeof(*jobs) * slotCount);
+	int i;
+	for(i = 0; i < slotCount; i++)
+	{
+		jobs[i].arena = createArena(ARENA_BLOCK_SIZE);
+		jobs[i].lengthLimit = lengthLimit;
+	}
+	unsigned char* index = arenaAlloc(arena, (size_t)blockCount * BLOCK_INDEX_ENTRY_SIZE + BLOCK_FOOTER_SIZE);
+	ThreadPool* pool = createThreadPool(threadCount);
 
-void append(List* list, Node* node)
-{
-	// If list is empty, add first node to list
-	if(list -> nodeCount == 0)
+	// Fill every slot, then write blocks in order, refilling each slot as its block is written
+	uint32_t block;
+	for(block = 0; block < blockCount && block < (uint32_t)slotCount; block++)
 	{
-		node -> left = NULL;
-		node -> right = NULL;
-		list -> head = node;
-		list -> tail = node;
+		submitBlock(pool, &jobs[block], original, block, blockSize);
 	}
+	unsigned char tag = FORMAT_BLOCKS;
+	writeOutput(compressed, &tag, 1);
+	for(block = 0; block < blockCount; block++)
+	{
+		BlockJob* job = &jobs[block % slotCount];
+		waitForTask(pool, &job -> done);
+		writeOutput(compressed, job -> output, job -> outputSize);
+		writeUint32(index + block * BLOCK_INDEX_ENTRY_SIZE, job -> outputSize);
+		writeUint32(index + block * BLOCK_INDEX_ENTRY_SIZE + 4, job -> size);
 
-	// Add all other nodes to list
-	else
+		if(block + slotCount < blockCount)
+		{
+			submitBlock(pool, job, original, block + slotCount, blockSize);
+		}
+	}
+
+	writeBlockIndex(compressed, index, blockCount, blockSize);
+	freeThreadPool(pool);
+	for(i = 0; i < slotCount; i++)
 	{
-		list -> tail -> right = node;
-		node -> left = list -> tail;
-		node -> right = NULL;
-		list -> tail = node;
+		freeArena(jobs[i].arena);
 	}
-	list -> nodeCount++;
 }
 
-void insertNode(List* list, Node* node)
+bool writeStream(Arena* arena, FILE* in, OutputFile* out, size_t blockSize, int threadCount, int lengthLimit)
 {
-	Node* current = list -> head;
-
-	// If adding in front
-	if(node -> frequency <= current -> frequency)
+	// Every slot holds one block being compressed, its input a block a reader thread filled ahead of time.
+	// Input blocks go back to the reader in order as their blocks are written
+	int slotCount = threadCount * 2;
+	BlockJob* jobs = arenaAlloc(arena, sizeof(*jobs) * slotCount);
+	int i;
+	for(i = 0; i < slotCount; i++)
 	{
-		list -> head = node;
-		current -> left = node;
-		node -> right = current;
+		jobs[i].arena = createArena(ARENA_BLOCK_SIZE);
+		jobs[i].lengthLimit = lengthLimit;
 	}
-	else
+	ReadAhead* readAhead = startReadAhead(fileno(in), slotCount + READ_AHEAD_BLOCKS, blockSize, true);
+	ThreadPool* pool = createThreadPool(threadCount);
+
+	// Keep every slot busy while input lasts, writing each block as soon as it is done
+	unsigned char tag = FORMAT_STREAM;
+	writeOutput(out, &tag, 1);
+	bool written = true;
+	uint64_t submitted = 0;
+	uint64_t block;
+	bool ended = false;
+	for(block = 0; ; block++)
 	{
-		// Iterate through list until appropriate place for node is found
-		while(node -> frequency > current -> frequency && (current -> right != NULL)) 
-		{
-			current = current -> right;
-		}
-		// If adding to end
-		if(node -> frequency > list -> tail -> frequency)
+		while(!ended && submitted < block + slotCount)
 		{
-			list -> tail = node;
-			current -> right = node;
-			node -> left = current;
+			BlockJob* job = &jobs[submitted % slotCount];
+			size_t size;
+			job -> data = acquireFilledSlot(readAhead -> ring, &size);
+			ended = (size == 0);
+			if(ended)
+			{
+				break;
+			}
+			job -> size = size;
+			resetArena(job -> arena);
+			submitTask(pool, compressBlock, job, &job -> done);
+			submitted++;
 		}
-		// If adding in the middle
-		else
+		if(block == submitted)
 		{
-			current -> left -> right = node;
-			node -> left = current -> left;
-			node -> right = current;
-			current -> left = node;
+			break;
 		}
-	}
-}
 
-void freeTree(List* list)
-{
-	// Recursively free nodes in list
-	Node* node = list -> head;
-	if(node != NULL)
-	{
-		freeTreeHelper(node);
+		// Sizes go before the block so a reader never has to seek
+		BlockJob* job = &jobs[block % slotCount];
+		waitForTask(pool, &job -> done);
+		unsigned char sizes[BLOCK_INDEX_ENTRY_SIZE];
+		writeUint32(sizes, job -> outputSize);
+		writeUint32(sizes + 4, job -> size);
+		writeOutput(out, sizes, BLOCK_INDEX_ENTRY_SIZE);
+		writeOutput(out, job -> output, job -> outputSize);
+		written = flushOutput(out) && written;
+		releaseSlot(readAhead -> ring);
 	}
 
-	// Free list itself
-	free(list);
-}
+	// Two zero sizes mark the end of the stream
+	unsigned char end[BLOCK_INDEX_ENTRY_SIZE] = {0};
+	writeOutput(out, end, BLOCK_INDEX_ENTRY_SIZE);
+	written = flushOutput(out) && written;
 
-void freeTreeHelper(Node* node)
-{
-	// Recurse on left child
-	if(node -> leftChild != NULL)
+	freeThreadPool(pool);
+	bool readable = stopReadAhead(readAhead);
+	for(i = 0; i < slotCount; i++)
 	{
-		freeTreeHelper(node -> leftChild);
+		freeArena(jobs[i].arena);
 	}
-
-	// Recurse on right child
-	if(node -> rightChild != NULL)
+	if(!readable || !written)
 	{
-		freeTreeHelper(node -> rightChild);
+		fprintf(stderr, "ERROR: Cannot stream data.\n");
+		return false;
 	}
-
-	// Free node
-	free(node);
+	return true;
 }
 
-void printTree(Node* node, int space)
+bool writeAdaptive(Arena* arena, FILE* in, OutputFile* out, size_t messageSize, int lengthLimit)
 {
-	// Base case
-	if(node == NULL)
+	// One message and its compressed form at a time, while a reader thread waits for the next
+	ReadAhead* readAhead = startReadAhead(fileno(in), READ_AHEAD_BLOCKS, messageSize, false);
+	BitWriter* writer = createMemoryBitWriter(arena, getCompressedBound(messageSize, lengthLimit));
+	AdaptiveModel* model = createAdaptiveModel(lengthLimit);
+
+	// The limit is the only setting the decoder needs to rebuild the same codes
+	unsigned char header[2] = {FORMAT_ADAPTIVE, lengthLimit};
+	writeOutput(out, header, sizeof(header));
+	bool written = true;
+
+	// A message is whatever one read returns, so it is sent without waiting for more input
+	size_t size;
+	while((size = takeReadAhead(readAhead)) > 0)
 	{
-		return;
+		encodeAdaptive(model, writer, readAhead -> block, size);
+		flushBitWriter(writer);
+
+		unsigned char sizes[BLOCK_INDEX_ENTRY_SIZE];
+		writeUint32(sizes, writer -> position);
+		writeUint32(sizes + 4, size);
+		writeOutput(out, sizes, BLOCK_INDEX_ENTRY_SIZE);
+		writeOutput(out, writer -> buffer, writer -> position);
+		written = flushOutput(out) && written;
+
+		// Memory writers keep their output, start the next message at the front
+		writer -> position = 0;
 	}
-	// Add level of spacing per iteration
-	space += 6; 
 
-	// Recurse on right child
-	printTree(node -> rightChild, space); 
-	printf("\n");
-	int i;
+	// Two zero sizes mark the end of the stream
+	unsigned char end[BLOCK_INDEX_ENTRY_SIZE] = {0};
+	writeOutput(out, end, BLOCK_INDEX_ENTRY_SIZE);
+	written = flushOutput(out) && written;
 
-	// Space out node from rest
-	for (i = 6; i < space; i++)
+	freeAdaptiveModel(model);
+	bool readable = stopReadAhead(readAhead);
+	if(!readable || !written)
 	{
-		printf(" "); 
+		fprintf(stderr, "ERROR: Cannot stream data.\n");
+		return false;
 	}
+	return true;
+}
 
-	// Print node
-	printNode(node);
-
-	// Recurse on left child
-	printTree(node -> leftChild, space); 
+void writeSynced(Arena* arena, InputFile* original, OutputFile* compressed, Code* codeTable, size_t interval)
+{
+	BitWriter* writer = createBitWriter(arena, compressed);
+
+	// Header is padded so the first segment starts on a byte boundary
+	writeBits(writer, FORMAT_SYNC, 8);
+	writeCodeLengths(writer, codeTable);
+	flushBitWriter(writer);
+
+	// Every segment ends in Pseudo-EOF and is padded, so a decoder can start at any of them
+	uint32_t segmentCount = (original -> size + interval - 1) / interval;
+	unsigned char* index = arenaAlloc(arena, (size_t)segmentCount * BLOCK_INDEX_ENTRY_SIZE + BLOCK_FOOTER_SIZE);
+	uint32_t segment;
+	for(segment = 0; segment < segmentCount; segment++)
+	{
+		size_t offset = (size_t)segment * interval;
+		size_t size = original -> size - offset < interval ? original -> size - offset : interval;
+		uint64_t start = getWriterOffset(writer);
+		encodeData(writer, codeTable, original -> data + offset, size);
+		writeBits(writer, codeTable[PSEUDO_EOF_VALUE].bits, codeTable[PSEUDO_EOF_VALUE].length);
+		flushBitWriter(writer);
+		writeUint32(index + segment * BLOCK_INDEX_ENTRY_SIZE, getWriterOffset(writer) - start);
+		writeUint32(index + segment * BLOCK_INDEX_ENTRY_SIZE + 4, size);
+	}
+
+	writeBlockIndex(compressed, index, segmentCount, interval);
 }
 
-int getMaxDepth(Node* node)
+void writeInterleaved(Arena* arena, InputFile* original, OutputFile* compressed, Code* codeTable)
 {
-	if(node == NULL)
+	BitWriter* writer = createBitWriter(arena, compressed);
+
+	// Header is padded so the first chunk starts on a byte boundary
+	writeBits(writer, FORMAT_INTERLEAVED, 8);
+	writeCodeLengths(writer, codeTable);
+	flushBitWriter(writer);
+
+	// Streams of a chunk are coded in memory, since their sizes come before them
+	BitWriter* streams[INTERLEAVE_STREAMS];
+	int stream;
+	for(stream = 0; stream < INTERLEAVE_STREAMS; stream++)
 	{
-		return 0;
+		streams[stream] = createMemoryBitWriter(arena, getCompressedBound(INTERLEAVE_CHUNK_SIZE / INTERLEAVE_STREAMS, getMaxCodeLength(codeTable)));
 	}
-	else
+	size_t offset;
+	for(offset = 0; offset < original -> size; offset += INTERLEAVE_CHUNK_SIZE)
 	{
-		int leftDepth = getMaxDepth(node -> leftChild);
-		int rightDepth = getMaxDepth(node -> rightChild);
-
-		// Add up depth of left and right sub-trees and add the largest to current depth
-		if(rightDepth > leftDepth)
-		{
-			return rightDepth + 1;
-		}
-		else
-		{
-			return leftDepth + 1;
-		}
+		size_t size = original -> size - offset < INTERLEAVE_CHUNK_SIZE ? original -> size - offset : INTERLEAVE_CHUNK_SIZE;
+		encodeInterleaved(writer, streams, codeTable, original -> data + offset, size);
 	}
+
+	// Chunk of size zero ends the file
+	unsigned char end[INTERLEAVE_HEADER_SIZE] = {0};
+	writeBytes(writer, end, INTERLEAVE_HEADER_SIZE);
+	flushBitWriter(writer);
 }
 
-void freeList(List* list)
+void writeBlockIndex(OutputFile* compressed, unsigned char* index, uint32_t blockCount, size_t blockSize)
 {
-	Node* node = list -> head;
-
-	// Error handling
-	if(node != NULL)
-	{
-		// Iterate through list, freeing every node
-		Node* next = node -> right;
-		while(next != NULL)
-		{
-			free(node -> code);
-			free(node);
-			node = next;
-			next = next -> right;
-		}
-		free(node -> code);
-		free(node);
-	}
-
-	// Free list itself
-	free(list);
+	// Index of block sizes, then the block size and count so the index can be found from the end
+	unsigned char* footer = index + (size_t)blockCount * BLOCK_INDEX_ENTRY_SIZE;
+	writeUint32(footer, blockSize);
+	writeUint32(footer + 4, blockCount);
+	writeOutput(compressed, index, (size_t)blockCount * BLOCK_INDEX_ENTRY_SIZE + BLOCK_FOOTER_SIZE);
 }
 
-void printList(List* list)
+void submitBlock(ThreadPool* pool, BlockJob* job, InputFile* original, uint32_t block, size_t blockSize)
 {
-	printf("\nLIST:\n");
-	Node* current = list -> head;
-	int i = 0;
-	
-	// Iterate through list printing every node
-	while(current != NULL)
-	{
-		printf("%d ", i);
-		i++;
-		printNode(current);
-		current = current -> right;
-	}
-	printf("\n");
+	// Block covers blockSize bytes, or whatever is left at the end of the file
+	size_t offset = (size_t)block * blockSize;
+	job -> data = original -> data + offset;
+	job -> size = original -> size - offset < blockSize ? original -> size - offset : blockSize;
+	resetArena(job -> arena);
+	submitTask(pool, compressBlock, job, &job -> done);
 }
 
-void printNode(Node* node)
+unsigned long getFileSize(FILE* fp)
 {
-	// If node has a code
-	if(node -> code != NULL)
-	{
-		if(node -> value == '\n')
-		{
-			printf("Node: (\\n, %ld, %s)\n", node -> frequency, node -> code);
-		}
-		else if(node -> value == ' ')
-		{
-			printf("Node: ( , %ld, %s)\n", node -> frequency, node -> code);
-		}
-		else if(node -> value == PSEUDO_EOF_VALUE)
-		{
-			printf("Node: (EOF, %ld, %s)\n", node -> frequency, node -> code);
-		}
-		else
-		{
-			printf("Node: (%d, %ld, %s)\n", node -> value, node -> frequency, node -> code);
-		}
-	}
-	// If node does not have a code
-	else
-	{
-		if(node -> value == '\n')
-		{
-			printf("Node: (\\n, %ld)\n", node -> frequency);
-		}
-		else if(node -> value == ' ')
-		{
-			printf("Node: ( , %ld)\n", node -> frequency);
-		}
-		else if(node -> value == PSEUDO_EOF_VALUE)
-		{
-			printf("Node: (EOF, %ld)\n",node -> frequency);
-		}
-		else
-		{
-			printf("Node: (%d, %ld)\n", node -> value, node -> frequency);
-		}
+	// Set original position
+	int originalPosition = ftell(fp);
+	
+	// Seek to end, record position
+	fseek(fp, 0L, SEEK_END);
+	long long fileSize = ftell(fp);
 
-	}
-}
+	// Seek back to original position
+	fseek(fp, 0L, originalPosition);
 
+	return fileSize;
+}
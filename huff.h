@@ -4,6 +4,12 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <time.h>
+
+#include "libhuff.h"
 
 //_______________________________________________________________________________________
 // DISCLAIMER
@@ -27,32 +33,566 @@
 // Frequency of Pseudo-EOF character, used when adding it to Huffman Tree
 #define PSEUDO_EOF_FREQUENCY 1
 
+// Number of nodes in a full binary tree with a leaf for every character
+#define MAX_NODE_COUNT (2 * ASCII_COUNT - 1)
+
+// Size in bytes of the buffers used for bit-level reading and writing
+#define BIT_BUFFER_SIZE (1 << 20)
+
+// Size in bytes of the memory blocks an arena hands out allocations from
+#define ARENA_BLOCK_SIZE (4 << 20)
+
+// Largest block a reset arena keeps for its next use, anything past it goes back to the system
+#define ARENA_RETAIN_LIMIT (16 << 20)
+
+// Alignment in bytes of every arena allocation
+#define ARENA_ALIGNMENT 16
+
+// Size in bytes of the first block read from inputs that cannot be mapped
+#define INPUT_READ_SIZE (1 << 20)
+
+// Size in bytes and number of the buffers output files are written through
+#define OUTPUT_BUFFER_SIZE (2 << 20)
+#define OUTPUT_BUFFER_COUNT 4
+
+// Number of buffers of input a reader thread may get ahead of the decoder or of the blocks being compressed
+#define READ_AHEAD_BLOCKS 4
+
+// Alignment in bytes of output buffers and of every write but the last, as direct I/O needs
+#define OUTPUT_ALIGNMENT 4096
+
+// Number of sub-tables the histogram spreads consecutive bytes across
+#define HISTOGRAM_TABLES 4
+
+// Number of bytes counted before 32-bit sub-table counters are added up
+#define HISTOGRAM_CHUNK_SIZE ((size_t)1 << 30)
+
+// Number of bits indexing the primary decoding table, longer codes use sub-tables
+#define DECODE_TABLE_BITS 11
+
+// Number of bits a code length takes at most in a canonical header
+#define CODE_LENGTH_BITS 6
+
+// Longest code the decoder reads in one lookahead, refillBits keeps at least this many bits buffered
+#define MAX_CODE_LENGTH 56
+
+// Shortest limit on code length that still fits every character
+#define MIN_CODE_LENGTH_LIMIT 9
+
+// Limit on code length unless another is given, keeps codes inside a primary and one sub-table
+#define DEFAULT_CODE_LENGTH_LIMIT 15
+
+// First byte of a header identifies its format. A tree header starts with a zero bit, or
+// is 0xC0 for an empty file, so tagged formats use a one bit followed by a zero bit
+#define FORMAT_TAG_MASK 0xC0
+#define FORMAT_TAG 0x80
+
+// Pre-order dump of the Huffman tree, written without a tag
+#define FORMAT_TREE 0
+
+// Code lengths of every character, codes are rebuilt canonically
+#define FORMAT_CANONICAL 0x81
+
+// Independently coded blocks with canonical headers, followed by an index of block sizes
+#define FORMAT_BLOCKS 0x82
+
+// Code lengths of every character, then byte-aligned segments that each end in Pseudo-EOF,
+// followed by an index of segment sizes so segments can be decoded concurrently
+#define FORMAT_SYNC 0x83
+
+// Blocks with canonical headers, each preceded by its compressed and original size, ending with
+// two zero sizes. Written and read in one pass so it can go through a pipe
+#define FORMAT_STREAM 0x84
+
+// Code length limit, then messages coded with a model both sides rebuild from the characters
+// seen so far. Each message is preceded by its compressed and original size, two zero sizes end it
+#define FORMAT_ADAPTIVE 0x85
+
+// Identifier of a trained model, then the data coded with the model's codes and Pseudo-EOF
+#define FORMAT_MODEL 0x86
+
+// Data as it is, for input Huffman coding cannot shrink
+#define FORMAT_STORED 0x87
+
+// Original size as 64 bits, then runs of one character, each the character and a 32-bit length,
+// until end of file. The runs add up to exactly the original size
+#define FORMAT_RUNS 0x88
+
+// Contexts with their own table, then the code lengths of every table, then the data with every
+// character coded by the table of the character before it, ending in Pseudo-EOF
+#define FORMAT_CONTEXT 0x89
+
+// Code lengths of every character, padded to a byte, then chunks whose characters are split into
+// INTERLEAVE_STREAMS equal parts, each coded as its own padded stream so they can be decoded side
+// by side. A chunk starts with its original size and the compressed size of every stream, a chunk
+// of size zero ends the file
+#define FORMAT_INTERLEAVED 0x8A
+
+// First byte of a block that is not Huffman coded. Its top three bits are a code length width
+// no header uses, so it cannot be mistaken for code lengths
+#define BLOCK_RAW_MARK 0x7
+#define BLOCK_STORED 0xE0 // Block contents follow as they are
+#define BLOCK_RUNS 0xE1 // Runs follow until the block's size is reached
+
+// Ways a file or block can be coded, picked from its counts
+#define ENCODING_HUFFMAN 0
+#define ENCODING_STORED 1
+#define ENCODING_RUNS 2
+
+// Number of characters coded with a model between checks that the output is still smaller than the input
+#define MODEL_CHUNK_SIZE (1 << 16)
+
+// Number of streams a chunk of an interleaved file is split into
+#define INTERLEAVE_STREAMS 4
+
+// Largest number of characters in a chunk of an interleaved file, small enough to stay in cache
+#define INTERLEAVE_CHUNK_SIZE (1 << 18)
+
+// Size in bytes of a chunk header: original size and the compressed size of every stream
+#define INTERLEAVE_HEADER_SIZE (4 + 4 * INTERLEAVE_STREAMS)
+
+// Longest code the bulk encoder packs, codes and lengths share 32 bits
+#define BULK_MAX_LENGTH 27
+#define BULK_LENGTH_BITS 5
+#define BULK_LENGTH_MASK 0x1F
+
+// Fewest characters worth packing the codes for the bulk encoder
+#define BULK_MIN_SIZE 256
+
+// Bytes the bulk encoder keeps free at the end of a buffer for its unaligned stores
+#define BULK_SLACK 16
+
+// Size in bytes of a run: the character and its length
+#define RUN_SIZE 5
+
+// Size in bytes of the original size in front of the runs of a runs file
+#define RUNS_HEADER_SIZE 8
+
+// Number of contexts of order-1 coding, one for every character that can come before
+#define CONTEXT_COUNT 256
+
+// Number of bits indexing the primary decoding table of a context, small so the tables of
+// every context stay in cache
+#define CONTEXT_DECODE_BITS 8
+
+// Number of times contexts are weighed against the shared table before it is built
+#define CONTEXT_ROUNDS 2
+
+// Estimated header bits of a context table, and for every character it codes
+#define CONTEXT_TABLE_BITS 16
+#define CONTEXT_CHARACTER_BITS 8
+
+// Largest size in bytes of the list of contexts with their own table
+#define CONTEXT_LIST_BOUND 1024
+
+// First bytes of a model file, "HUFM"
+#define MODEL_MAGIC 0x4855464D
+
+// Size in bytes of the magic and identifier at the start of a model file
+#define MODEL_HEADER_SIZE 8
+
+// Number of characters coded before an adaptive model is first rebuilt, doubling after every rebuild
+#define ADAPTIVE_FIRST_INTERVAL 256
+
+// Largest number of characters between rebuilds of an adaptive model
+#define ADAPTIVE_MAX_INTERVAL (1 << 15)
+
+// Largest size in bytes of a code length header, with every character at the longest length
+#define CODE_LENGTHS_BOUND 1024
+
+// Size in bytes of the blocks compressed in parallel unless another is given
+#define DEFAULT_BLOCK_SIZE (1 << 20)
+
+// Largest block size, block sizes must fit the 32-bit fields of the index
+#define MAX_BLOCK_SIZE (1 << 30)
+
+// Size in bytes of an index entry: compressed size and original size of a block
+#define BLOCK_INDEX_ENTRY_SIZE 8
+
+// Size in bytes of the block index footer: block size and block count
+#define BLOCK_FOOTER_SIZE 8
+
+// Results of decoding characters into a buffer
+#define DECODE_END 0 // Pseudo-EOF reached
+#define DECODE_FULL 1 // Buffer filled before Pseudo-EOF
+#define DECODE_INVALID 2 // Bits match no code
+#define DECODE_TRUNCATED 3 // Input ends before Pseudo-EOF
+
+// Stages timed by --stats
+#define STATS_INPUT 0 // Opening and mapping the input
+#define STATS_FREQUENCY 1 // Counting characters
+#define STATS_TREE 2 // Building the Huffman tree
+#define STATS_CODES 3 // Turning the tree into limited, canonical codes
+#define STATS_ENCODE 4 // Writing header and data
+#define STATS_HEADER 5 // Reading the header
+#define STATS_TABLE 6 // Building the decoding table
+#define STATS_DECODE 7 // Decoding and writing data
+#define STATS_STAGE_COUNT 8
+
+// Counters kept by --stats
+#define STATS_BYTES_IN 0 // Bytes of files read
+#define STATS_BYTES_OUT 1 // Bytes of files written
+#define STATS_SYMBOLS 2 // Characters of original data
+#define STATS_COMPRESSED_BYTES 3 // Bytes of compressed data
+#define STATS_READ_CALLS 4 // Calls reading a file
+#define STATS_WRITE_CALLS 5 // Calls writing a file
+#define STATS_MAP_CALLS 6 // Files mapped into memory
+#define STATS_COUNTER_COUNT 7
+
+// Instrumentation for --stats, compiled out entirely unless HUFF_STATS is defined
+#ifdef HUFF_STATS
+#define STATS_START(timer) StatsTimer timer; startStatsTimer(&timer)
+#define STATS_STAGE(timer, stage) stopStatsTimer(&timer, stage)
+#define STATS_ADD(counter, amount) addStatsCount(counter, amount)
+#define STATS_CODE_LENGTHS(codeTable) recordCodeLengths(codeTable)
+#else
+#define STATS_START(timer)
+#define STATS_STAGE(timer, stage)
+#define STATS_ADD(counter, amount)
+#define STATS_CODE_LENGTHS(codeTable)
+#endif
+
 //_______________________________________________________________________________________
 // STRUCTURES
 
 typedef struct Node Node;
 typedef struct Dictionary Dictionary;
+typedef struct ArenaBlock ArenaBlock;
+typedef struct OutputFile OutputFile;
+typedef struct ReadAhead ReadAhead;
 
-// Functions as a node in a doubly-linked list as well as a node in a
-// binary tree for easy construction of Huffman tree from list
+// Node of a Huffman tree, children are referenced by their index in the tree's node array
 struct Node
 {				
 	int        	value; // Numerical representation of ASCII character
 	unsigned long   frequency; // Number of times character happens in given file
-	Node*       	left; // List neighbor to left
-	Node*      	right; // List neighbor to right
-	Node*  		leftChild; // Tree child to left
-	Node* 		rightChild; // Tree child to right
-	char*     	code; // Bit code generated from node's position in Huffman tree
+	int16_t		leftChild; // Index of tree child to left, -1 for a leaf
+	int16_t		rightChild; // Index of tree child to right, -1 for a leaf
+};
+
+// Huffman tree stored contiguously, leaves first in ascending frequency, then parents
+// in the order they were created
+typedef struct
+{
+	Node		nodes[MAX_NODE_COUNT]; // All nodes of the tree
+	int		nodeCount; // Number of nodes in use
+	int		root; // Index of root node
+} Tree;
+
+// Block of memory owned by an arena, followed directly by the memory itself
+struct ArenaBlock
+{
+	ArenaBlock*	next; // Block added before this one
+	size_t		size; // Number of bytes of memory in block
+	size_t		used; // Number of bytes already handed out
+	unsigned char*	memory; // Start of memory
+};
+
+// Hands out memory for one file at a time, everything is released at once by a reset
+typedef struct
+{
+	ArenaBlock*	blocks; // Most recently added block, where allocations are made
+	size_t		blockSize; // Size of new blocks
+	void*		last; // Most recent allocation, can grow in place
+	unsigned long	allocationCount; // Number of allocations since last reset
+	unsigned long	bytesAllocated; // Number of bytes handed out since last reset
+	unsigned long	systemAllocations; // Number of blocks allocated since last reset
+} Arena;
+
+// Whole contents of an input file, mapped into memory when possible
+typedef struct
+{
+	const unsigned char*	data; // Contents of file
+	size_t			size; // Number of bytes in file
+	bool			mapped; // True if data is a memory mapping, false if it was read
+} InputFile;
+
+// Bit code of a single character, packed into an integer for table lookup
+typedef struct
+{
+	uint64_t	bits; // Code right-aligned, most significant bit is written first
+	int		length; // Number of bits in code, 0 if character does not appear
+} Code;
+
+// Packs bits into a 64-bit register and flushes whole words into a large buffer
+typedef struct
+{
+	uint64_t	bits; // Pending bits, right-aligned
+	int		count; // Number of pending bits in register
+	unsigned char*	buffer; // Output buffer, the one being filled by the output file for file writers
+	size_t		capacity; // Number of bytes in buffer
+	size_t		position; // Number of bytes used in buffer
+	OutputFile*	output; // File the buffer belongs to, NULL if output stays in memory
+} BitWriter;
+
+// Reads bits from a large buffer through a left-aligned 64-bit register
+typedef struct
+{
+	uint64_t	bits; // Buffered bits, next bit to read is the most significant
+	int		count; // Number of valid bits in register
+	unsigned char*	buffer; // Input buffer of BIT_BUFFER_SIZE bytes
+	size_t		position; // Next unread byte in buffer
+	size_t		size; // Number of bytes in buffer
+	unsigned long	bytesRead; // Number of bytes already read into buffer
+	int		overrun; // Number of zero bytes supplied after end of file
+	FILE*		fp; // File the buffer is read from, NULL if all input is in the buffer
+	ReadAhead*	readAhead; // Thread reading the file ahead into blocks, NULL if it is read here
+} BitReader;
+
+// Entry of a decoding table, resolves up to two characters or links to a sub-table
+typedef struct
+{
+	uint32_t	next; // Offset of sub-table when entry is a link
+	uint16_t	symbol; // First character resolved
+	uint8_t		second; // Second character resolved, if count is 2
+	uint8_t		count; // Number of characters resolved, 0 if entry is a link
+	uint8_t		length; // Number of bits consumed by this entry
+	uint8_t		width; // Number of bits indexing the sub-table when entry is a link
+} DecodeEntry;
+
+// Primary decoding table followed by its sub-tables in one array
+typedef struct
+{
+	DecodeEntry*	entries; // Primary table at offset 0, then sub-tables
+	uint32_t	size; // Number of entries in use
+	uint32_t	capacity; // Number of entries allocated
+	int		maxLength; // Longest code in table
+} DecodeTable;
+
+// Work handed to a thread pool, 'done' is set once the function has returned
+typedef struct
+{
+	void		(*function)(void*); // Function to run
+	void*		argument; // Argument passed to function
+	bool*		done; // Flag set when finished, may be NULL
+} Task;
+
+// Fixed set of worker threads taking tasks from a bounded queue
+typedef struct
+{
+	pthread_t*	threads; // Worker threads
+	int		threadCount; // Number of worker threads
+	Task*		tasks; // Circular queue of waiting tasks
+	int		capacity; // Number of tasks queue can hold
+	int		head; // Index of next task to run
+	int		count; // Number of waiting tasks
+	bool		stopping; // True once workers should exit after the queue is empty
+	pthread_mutex_t	lock; // Protects queue and done flags
+	pthread_cond_t	available; // Signalled when a task is queued or pool stops
+	pthread_cond_t	finished; // Signalled when a task is taken or finished
+} ThreadPool;
+
+// Bounded queue of aligned blocks from one producer thread to one consumer thread. The semaphores count
+// the slots each side may take, so neither side locks and each index is touched by one thread only
+typedef struct
+{
+	unsigned char**	buffers; // Buffer of every slot, NULL until the slot is first filled
+	size_t*		sizes; // Number of bytes the producer put in every slot
+	int		slotCount; // Number of slots
+	size_t		slotSize; // Number of bytes in each buffer
+	uint64_t	acquired; // Number of slots the producer has taken to fill
+	uint64_t	published; // Number of slots the producer has handed over
+	uint64_t	taken; // Number of slots the consumer has taken, they are released in the same order
+	sem_t		free; // Slots the producer may fill
+	sem_t		filled; // Slots the consumer may take
+	bool		failed; // True once a slot's buffer could not be allocated
+	bool		stopping; // True once either side has given up on the other, read and written atomically
+} BlockRing;
+
+// Thread reading a descriptor into the slots of a ring, ending with an empty slot at end of input
+struct ReadAhead
+{
+	int			fd; // Descriptor read from
+	BlockRing*		ring; // Blocks read and not yet released
+	bool			whole; // Fill every block until the input ends instead of taking what one read returns
+	bool			failed; // True once a read has failed
+	pthread_t		thread; // Reader thread
+	int			wake[2]; // Pipe written to on stopping, to end a wait for input, -1 if it cannot be made
+	const unsigned char*	block; // Block the consumer holds, for consumers taking one at a time
+	bool			holding; // True while the consumer holds a block
+	bool			ended; // True once the consumer has taken the empty block
+};
+
+// Output written through a ring of large aligned buffers, filled here and written by a writer thread
+struct OutputFile
+{
+	int		fd; // Descriptor written to
+	char*		filename; // Name given in errors
+	bool		owned; // True if the descriptor is closed with the output
+	bool		direct; // True while writes bypass the page cache
+	bool		directWanted; // True if aligned writes should bypass the page cache, until the file system refuses
+	bool		failed; // True once a write has failed
+	BlockRing*	ring; // Buffers handed to the writer thread
+	unsigned char*	buffer; // Buffer being filled, a slot of the ring
+	size_t		capacity; // Number of bytes in buffer
+	size_t		position; // Number of bytes used in buffer
+	uint64_t	offset; // Number of bytes of output before the buffer
+	uint64_t	written; // Number of bytes written to the file, by the writer thread while it runs
+	pthread_t	thread; // Writer thread
+	bool		started; // True once the writer thread runs, when the first buffer is handed over
 };
 
-// Manages doubly-linked list
-typedef struct 
+// Block of the input compressed on its own by a worker
+typedef struct
+{
+	Arena*			arena; // Memory for the block, reset before every block
+	const unsigned char*	data; // Contents of the block
+	size_t			size; // Number of bytes in block
+	int			lengthLimit; // Longest code allowed
+	unsigned char*		output; // Compressed block
+	size_t			outputSize; // Number of bytes in compressed block
+	bool			done; // True once output is ready
+} BlockJob;
+
+// Position of a compressed block in the file and of its contents in the original file
+typedef struct
+{
+	uint64_t	compressedOffset; // Offset of block in compressed file
+	uint64_t	originalOffset; // Offset of block contents in original file
+	uint32_t	compressedSize; // Number of bytes in compressed block
+	uint32_t	originalSize; // Number of bytes of original contents
+} BlockEntry;
+
+// Index read from the end of a block file
+typedef struct
+{
+	BlockEntry*	blocks; // Entry for every block, in order
+	uint32_t	blockCount; // Number of blocks
+	uint32_t	blockSize; // Original size of every block but the last
+	uint64_t	originalSize; // Number of bytes in original file
+} BlockIndex;
+
+// Block or segment decoded by a worker straight into its place in the output file
+typedef struct
+{
+	Arena*		arena; // Memory for the segment, reset before every segment
+	DecodeTable*	table; // Decoding table shared by every segment, NULL if segments have their own header
+	BlockEntry*	block; // Position of the segment in both files
+	uint32_t	number; // Index of the segment, for error messages
+	int		input; // Descriptor of the compressed file
+	int		output; // Descriptor of the decompressed file
+	char*		filename; // Name of the compressed file, for error messages
+	bool		success; // True if the segment decoded to its expected size
+	bool		done; // True once the segment is written
+} DecodeJob;
+
+// Block or sync file opened for reading arbitrary ranges of the original contents
+typedef struct
 {
-	int nodeCount; // Number of nodes in list
-	Node*    head; // Head of list
-	Node*    tail; // Tail of list
-} List;
+	FILE*		fp; // Compressed file
+	Arena*		arena; // Memory for the index and shared table
+	Arena*		blockArena; // Memory for the decoded block, reset for every block
+	DecodeTable*	table; // Decoding table shared by every segment, NULL for block files
+	BlockIndex*	index; // Position of every block in both files
+	char*		filename; // Name of the compressed file, for error messages
+	int64_t		cachedBlock; // Index of the block in cachedData, -1 if none
+	unsigned char*	cachedData; // Contents of the most recently decoded block
+} SeekableFile;
+
+// Model that encoder and decoder rebuild in lockstep from the characters coded so far
+typedef struct
+{
+	unsigned long	frequencies[ASCII_COUNT]; // Count of every character seen, starting at one
+	Code		codes[ASCII_COUNT]; // Canonical codes from the last rebuild
+	DecodeTable*	table; // Decoding table for the codes, NULL until the decoder builds it
+	Arena*		arena; // Memory for the codes' tree and table, reset at every rebuild
+	int		lengthLimit; // Longest code allowed
+	uint64_t	seen; // Number of characters coded
+	uint64_t	nextRebuild; // Value of seen at which the codes are rebuilt
+	uint64_t	interval; // Number of characters until the rebuild after next
+} AdaptiveModel;
+
+// Codes trained on sample data, shared by every file compressed with them
+typedef struct
+{
+	uint32_t	id; // Hash of the code lengths, written in place of a header
+	Code		codes[ASCII_COUNT]; // Canonical codes, every character has one
+	DecodeTable*	table; // Decoding table, NULL until the model is read for decoding
+} Model;
+
+// Order-1 codes, picked by the character before. Contexts that gain from it have their own table,
+// the rest share one
+typedef struct
+{
+	uint16_t	tableOf[CONTEXT_COUNT]; // Table coding the characters after each character
+	Code		(*codes)[ASCII_COUNT]; // Canonical codes of every table, the shared one last
+	DecodeTable**	tables; // Decoding table of every table, NULL until the model is read for decoding
+	int		tableCount; // Number of tables, including the shared one
+	int		lookahead; // Bits to buffer before a lookup, enough for the longest code of any table
+	unsigned char	previous; // Character before the next one to decode
+	uint64_t	bits; // Size of data and headers, estimated when the model is built
+} ContextModel;
+
+// Memory and settings reused across library calls
+struct HuffContext
+{
+	Arena*		arena; // Memory for one call, reset at the start of every call
+	Arena*		blockArena; // Memory for the table of one block, reset for every block
+	Arena*		modelArena; // Memory for the model, reset when it is replaced
+	Model*		model; // Model used in place of per-call codes, NULL if none
+	int		lengthLimit; // Longest code huff_compress may write
+	int		order; // Characters before each one its codes depend on, 0 or 1
+};
+
+// Block or sync file opened through the library for reading ranges
+struct HuffRange
+{
+	SeekableFile*	file; // File and its index, with the most recently decoded block
+};
+
+// File handled by a batch worker, the slot's arena is reused for every file it is given
+typedef struct
+{
+	Arena*		arena; // Memory for the file, reset before every file
+	char*		filename; // File to process
+	bool		(*process)(Arena*, char*, void*); // Compresses or decompresses one file
+	void*		options; // Settings shared by every file, passed to process
+	uint64_t	size; // Number of bytes in the file
+	double		seconds; // Time taken by the file
+	bool		success; // True if process succeeded
+	bool		done; // True once the file is finished
+} FileJob;
+
+// Settings for compressing a file, shared by every file of a batch
+typedef struct
+{
+	bool		canonical; // Write code lengths instead of the tree
+	bool		adaptive; // Write adaptive messages
+	bool		context; // Code every character with a table picked by the one before
+	bool		interleaved; // Split the data into streams decoded side by side
+	bool		blockMode; // Write independently coded blocks
+	bool		memoryUsage; // Print arena usage after the file
+	int		lengthLimit; // Longest code allowed
+	int		threadCount; // Threads compressing the blocks of one file
+	size_t		blockSize; // Size of blocks and adaptive messages
+	size_t		syncInterval; // Bytes between sync points, 0 for none
+	Model*		model; // Trained model replacing per-file codes, NULL if none
+	bool		direct; // Write output bypassing the page cache where supported
+} CompressOptions;
+
+// Settings for decompressing a file, shared by every file of a batch
+typedef struct
+{
+	bool		memoryUsage; // Print arena usage after the file
+	int		threadCount; // Threads decoding the blocks or segments of one file
+	Model*		model; // Trained model for files written with one, NULL if none
+	bool		direct; // Write output bypassing the page cache where supported
+} DecompressOptions;
+
+// Start of the stage being timed, on the wall clock and the calling thread's CPU clock
+typedef struct
+{
+	struct timespec	wall; // Monotonic time
+	struct timespec	cpu; // Thread CPU time
+} StatsTimer;
+
+// Item of a package-merge list, either a single character or a package of two items
+typedef struct
+{
+	uint64_t	weight; // Total frequency of the item
+	int		symbol; // Character of a leaf, -1 for a package
+} PackageItem;
+
 
 //_______________________________________________________________________________________
 // FUNCTIONS
@@ -61,66 +601,587 @@ typedef struct
 // 								  **** HUFF.C ****
 
 
+// Compresses one file with the given CompressOptions, returns false on error
+bool compressFile(Arena* arena, char* filename, void* options);
+
 // Returns the frequency of all ASCII characters in the file in an arry
-unsigned long* getFrequency(char* filename);
+unsigned long* getFrequency(Arena* arena, InputFile* input);
+
+// Creates and opens filename.huff in the compressed output directory
+OutputFile* openCompressed(Arena* arena, char* originalFilename, bool direct);
+
+// Counts every sample file and writes a model trained on them to 'modelFilename'
+bool writeTrainedModel(Arena* arena, char* modelFilename, char** samples, int sampleCount, int lengthLimit);
+
+// Writes the model's identifier and the data coded with the model's codes. Returns false and
+// writes nothing if that would not be smaller than storing the data
+bool writeWithModel(Arena* arena, InputFile* original, OutputFile* compressed, Model* model);
+
+// Writes the data stored or as runs, picked by chooseEncoding
+void writeRaw(Arena* arena, InputFile* original, OutputFile* compressed, int encoding);
+
+// Writes the data with one set of canonical codes as chunks of interleaved streams
+void writeInterleaved(Arena* arena, InputFile* original, OutputFile* compressed, Code* codeTable);
 
-// Sorts characters by frequency, then puts the data into a doubly linked list
-List* frequencySort(unsigned long* asciiFrequency);
+// Writes the data with order-1 codes, or stored if they cannot shrink it
+void writeContexts(Arena* arena, InputFile* original, OutputFile* compressed, int lengthLimit);
 
-// Creates the binary huffman tree based on the frequency list
-void createTree(List* frequencyList);
+// Using the tree and table of encodings, write data by bit to file
+void writeCompressed(Arena* arena, InputFile* original, OutputFile* compressed, Code* codeTable, Tree* encodingTree, bool canonical);
 
-// Sets the 'code' field of the Node structure to the binary code generated from tree
-List* getBitEncodings(Node* encodingTree);
+// Splits the data into blocks, compresses them on a thread pool and writes them with an index
+void writeBlocks(Arena* arena, InputFile* original, OutputFile* compressed, size_t blockSize, int threadCount, int lengthLimit);
 
-// Using the tree and list of encodings, write data by bit to file
-void writeCompressed(char* originalFilename, List* encodingList, Node* encodingTree);
+// Writes the data with one set of canonical codes, adding a sync point every 'interval' bytes
+void writeSynced(Arena* arena, InputFile* original, OutputFile* compressed, Code* codeTable, size_t interval);
+
+// Compresses 'in' to 'out' in one pass, a block at a time with the blocks compressed on a thread pool
+bool writeStream(Arena* arena, FILE* in, OutputFile* out, size_t blockSize, int threadCount, int lengthLimit);
+
+// Compresses 'in' to 'out' as messages of up to 'messageSize' bytes with an adaptive model,
+// writing every message as soon as it is read
+bool writeAdaptive(Arena* arena, FILE* in, OutputFile* out, size_t messageSize, int lengthLimit);
+
+// Writes the index of block sizes filled in by the caller, followed by the footer
+void writeBlockIndex(OutputFile* compressed, unsigned char* index, uint32_t blockCount, size_t blockSize);
 
 
 // 								**** UNHUFF.C ****
 
 
-// Reconstructs Huffman tree from header
-Node* reconstructTree(FILE* fp, unsigned char* byte, int* level);
+// Decompresses one file with the given DecompressOptions, returns false on error
+bool decompressFile(Arena* arena, char* filename, void* options);
+
+// Creates and opens filename.unhuff in the uncompressed output directory
+OutputFile* openDecompressed(Arena* arena, char* filename, bool direct);
+
+// Using the decoding table, decompresses characters up to Pseudo-EOF and writes them to file
+bool writeDecompressed(BitReader* reader, DecodeTable* table, OutputFile* decompressed, char* fileName, unsigned long* length);
+
+// Copies the rest of a stored file to 'decompressed'
+bool writeStored(BitReader* reader, OutputFile* decompressed);
+
+// Expands the runs of a runs file into 'decompressed'
+bool writeRuns(BitReader* reader, OutputFile* decompressed, char* filename);
+
+// Decompresses the chunks of an interleaved file, decoding the streams of each chunk together
+bool decompressInterleaved(Arena* arena, BitReader* reader, OutputFile* decompressed, char* filename);
+
+// Decompresses the order-1 codes of a context file
+bool decompressContexts(Arena* arena, BitReader* reader, OutputFile* decompressed, char* filename);
+
+// Decompresses the messages of an adaptive file in order as they are read
+bool decompressAdaptive(BitReader* reader, OutputFile* decompressed, char* filename);
+
+// Decompresses the blocks of a stream file in order as they are read
+bool decompressStream(BitReader* reader, OutputFile* decompressed, char* filename);
+
+// Decompresses the blocks or segments listed in the index on a thread pool,
+// 'table' is NULL when every block has its own code lengths
+bool decompressSegments(FILE* fp, DecodeTable* table, uint64_t firstOffset, OutputFile* decompressed, char* filename, int threadCount);
+
+// Writes 'length' bytes of the original file starting at 'offset', decoding only the blocks that hold them
+bool writeRange(char* filename, uint64_t offset, uint64_t length, OutputFile* decompressed);
+
+
+// 								**** ENCODE.C ****
+
+
+// Writes the code of every character in 'data', with the bulk kernel when built with HUFF_BULK_ENCODE
+void encodeData(BitWriter* writer, Code* codeTable, const unsigned char* data, size_t size);
+
+// Writes one code at a time through writeBits
+void encodeDataScalar(BitWriter* writer, Code* codeTable, const unsigned char* data, size_t size);
+
+// Merges groups of packed codes into a 64-bit accumulator without branches and stores their whole
+// bytes once per group, falling back to writeBits for short inputs and codes over BULK_MAX_LENGTH
+void encodeDataBulk(BitWriter* writer, Code* codeTable, const unsigned char* data, size_t size);
+
+// Writes the tree in pre-order, a zero for every parent and a one followed by nine bits for every leaf
+void encodeHeader(BitWriter* writer, Tree* tree, int node);
+
+// Counts, models and encodes one block into memory, run by a worker
+void compressBlock(void* argument);
+
+// Picks how to code data from its counts: stored when the entropy bound leaves nothing to gain,
+// runs when they take less room than the bound, otherwise Huffman codes
+int chooseEncoding(unsigned long* frequencies, const unsigned char* data, size_t size);
+
+// Codes the parts of one chunk into the memory writers 'streams', then writes the chunk header and
+// streams to a writer at a byte boundary
+void encodeInterleaved(BitWriter* writer, BitWriter** streams, Code* codeTable, const unsigned char* data, size_t size);
+
+// Returns the size in bytes, at most, of data with these counts written in the sync format
+uint64_t getSyncedSize(Arena* arena, Code* codeTable, unsigned long* frequencies, size_t size, size_t interval);
+
+// Returns the size in bytes of data with these counts written in the canonical format
+uint64_t getCanonicalSize(Arena* arena, Code* codeTable, unsigned long* frequencies);
+
+// Returns the size in bytes, at most, of data with these counts written in the interleaved format
+uint64_t getInterleavedSize(Arena* arena, Code* codeTable, unsigned long* frequencies, size_t size);
+
+// Writes the data as runs of one character, the writer must be at a byte boundary
+void encodeRuns(BitWriter* writer, const unsigned char* data, size_t size);
+
 
-// Using the huffman tree, decompresses and writes characters to file
-void writeDecompressed(FILE* fp, Node* tree, char* fileName, unsigned char* byte, int* level);
+// 								**** DECODE.C ****
+
+
+// Returns the format tag of the header, consuming it unless the header is a tree dump
+int readFormat(BitReader* reader);
+
+// Reconstructs Huffman tree from header, returns NULL if header is invalid
+Tree* reconstructTree(Arena* arena, BitReader* reader);
+
+// Builds multi-character lookup tables from the bit codes of the Huffman tree
+DecodeTable* buildDecodeTable(Arena* arena, Code* codeTable);
+
+// Builds lookup tables that resolve one character at a time
+DecodeTable* createDecodeTable(Arena* arena, Code* codeTable);
+
+// Like createDecodeTable, with a primary table indexed by 'width' bits, at most DECODE_TABLE_BITS
+DecodeTable* createDecodeTableOfWidth(Arena* arena, Code* codeTable, int width);
+
+// Decodes characters into 'output' until Pseudo-EOF or until fewer than two bytes are left, returns a DECODE_ result
+int decodeSymbols(BitReader* reader, DecodeTable* table, unsigned char* output, size_t capacity, size_t* position);
+
+// Like decodeSymbols, but fills 'output' to the last byte, returning DECODE_FULL only if more characters follow
+int decodeIntoBuffer(BitReader* reader, DecodeTable* table, unsigned char* output, size_t capacity, size_t* position);
+
+// Decodes the streams of one chunk, which follow each other in 'input', into 'size' characters.
+// Returns false if a stream holds an invalid code or is too short for its part
+bool decodeInterleaved(DecodeTable* table, const unsigned char* input, uint32_t* streamSizes, unsigned char* output, size_t size);
+
+// Decodes 'size' characters with the adaptive model, returns false if the input is invalid
+bool decodeAdaptive(AdaptiveModel* model, BitReader* reader, unsigned char* output, size_t size);
+
+// Decodes one block or segment into memory from the arena, returns NULL if it is invalid
+unsigned char* decodeBlock(Arena* arena, int fd, BlockEntry* block, DecodeTable* table, uint32_t number, char* filename);
+
+// Returns true if the block at the reader's byte boundary is stored or runs rather than Huffman coded
+bool isRawBlock(BitReader* reader);
+
+// Decodes a stored or runs block of exactly 'size' bytes, returns false if it is invalid
+bool decodeRawBlock(BitReader* reader, unsigned char* output, size_t size);
+
+// Reads the index at the end of a block file, returns NULL if it is invalid or the first block
+// does not start at 'firstOffset'
+BlockIndex* readBlockIndex(Arena* arena, FILE* fp, uint64_t firstOffset);
+
+
+// 								**** SEEK.C ****
+
+
+// Opens a block or sync file and reads its index, returns NULL if the file has no index
+SeekableFile* openSeekable(char* filename);
+
+// Copies up to 'length' bytes of the original file starting at 'offset' into 'output',
+// 'copied' is less than 'length' only when the range passes the end of the file
+bool readRange(SeekableFile* file, uint64_t offset, size_t length, unsigned char* output, size_t* copied);
+
+void closeSeekable(SeekableFile* file);
+
+
+// 								**** ADAPTIVE.C ****
+
+
+// Creates a model with equal counts for every character
+AdaptiveModel* createAdaptiveModel(int lengthLimit);
+
+// Rebuilds the codes from the counts so far and schedules the next rebuild
+void rebuildAdaptiveCodes(AdaptiveModel* model);
+
+// Writes the codes of 'size' characters, updating the model after each one
+void encodeAdaptive(AdaptiveModel* model, BitWriter* writer, const unsigned char* data, size_t size);
+
+void freeAdaptiveModel(AdaptiveModel* model);
+
+
+// 								**** MODEL.C ****
+
+
+// Builds a model from the counts of sample data, giving every character a code
+Model* trainModel(Arena* arena, unsigned long* frequencies, int lengthLimit);
+
+// Returns the identifier of a set of code lengths
+uint32_t getModelId(Code* codeTable);
+
+// Serializes a model into memory from the arena, returns its size
+size_t writeModel(Arena* arena, Model* model, unsigned char** data);
+
+// Reads a serialized model and builds its decoding table, returns NULL if it is invalid
+Model* readModel(Arena* arena, const unsigned char* data, size_t size);
+
+// Reads a model file, returns NULL if it cannot be read or is invalid
+Model* loadModel(Arena* arena, char* filename);
+
+
+// 								**** CONTEXT.C ****
+
+
+// Counts every pair of characters and builds a table for every context that gains from one,
+// and a shared table for the rest
+ContextModel* buildContextModel(Arena* arena, const unsigned char* data, size_t size, int lengthLimit);
+
+// Writes which contexts have their own table, then the code lengths of every table
+void writeContextModel(BitWriter* writer, ContextModel* model);
+
+// Writes the code of every character from the table of the one before, then Pseudo-EOF
+void encodeContexts(BitWriter* writer, ContextModel* model, const unsigned char* data, size_t size);
+
+// Reads the tables written by writeContextModel and builds their decoding tables, returns NULL if invalid
+ContextModel* readContextModel(Arena* arena, BitReader* reader);
+
+// Decodes characters into 'output' until Pseudo-EOF or until it is full, returns a DECODE_ result.
+// The model remembers the last character, so decoding can continue into another buffer
+int decodeContexts(ContextModel* model, BitReader* reader, unsigned char* output, size_t capacity, size_t* position);
+
+
+// 								**** BITIO.C ****
+
+
+// Creates a bit writer that fills the buffers of the given output file, after whatever it holds
+BitWriter* createBitWriter(Arena* arena, OutputFile* output);
+
+// Creates a bit writer that keeps up to 'capacity' bytes of output in memory
+BitWriter* createMemoryBitWriter(Arena* arena, size_t capacity);
+
+// Creates a bit writer into a caller's buffer, which must be big enough for all of the output
+BitWriter* createBufferBitWriter(Arena* arena, unsigned char* buffer, size_t capacity);
+
+// Appends the lowest 'length' bits of 'bits' to the output, most significant first
+void writeBits(BitWriter* writer, uint64_t bits, int length);
+
+// Pads the last byte with zeros and moves all pending output to the buffer, which file writers
+// hand back to their output file
+void flushBitWriter(BitWriter* writer);
+
+// Discards everything written to a memory writer, so its buffer can be filled again
+void rewindBitWriter(BitWriter* writer);
+
+// Appends whole bytes to a writer at a byte boundary
+void writeBytes(BitWriter* writer, const unsigned char* data, size_t size);
+
+// Returns the number of whole bytes written so far, for a writer at a byte boundary
+uint64_t getWriterOffset(BitWriter* writer);
+
+
+// Creates a bit reader that inputs from the given file
+BitReader* createBitReader(Arena* arena, FILE* fp);
+
+// Fills the register with at least 56 bits, padding with zeros after end of file
+void refillBits(BitReader* reader);
+
+// Removes and returns the next 'length' bits, at most 32
+uint32_t readBits(BitReader* reader, int length);
+
+// Creates a bit reader over 'size' bytes already in memory
+BitReader* createMemoryBitReader(Arena* arena, const unsigned char* data, size_t size);
+
+// Sets up a bit reader the caller owns over 'size' bytes already in memory
+void initMemoryBitReader(BitReader* reader, const unsigned char* data, size_t size);
+
+// Returns the next 'length' bits without removing them, at most 32
+uint32_t peekBits(BitReader* reader, int length);
+
+// Skips to the start of the next byte
+void alignToByte(BitReader* reader);
+
+// Copies up to 'size' bytes from a reader at a byte boundary, reading no more of the file than
+// needed. Returns the number of bytes copied, less than 'size' only at end of file
+size_t readBytes(BitReader* reader, unsigned char* output, size_t size);
+
+// Returns the offset in the input of the next unread byte, for a reader at a byte boundary
+unsigned long getReaderOffset(BitReader* reader);
+
+// Starts a thread reading the rest of a file reader's input ahead of decoding, unless it is all buffered
+void startPrefetch(BitReader* reader);
+
+// Stops the thread reading ahead, if any. Returns false if one of its reads failed
+bool stopPrefetch(BitReader* reader);
+
+// Writes and reads positive integers as Elias gamma codes, short for small values
+void writeGamma(BitWriter* writer, uint32_t value);
+uint32_t readGamma(BitReader* reader);
+
+// Stores and loads 32-bit and 64-bit integers most significant byte first
+void writeUint32(unsigned char* buffer, uint32_t value);
+uint32_t readUint32(const unsigned char* buffer);
+void writeUint64(unsigned char* buffer, uint64_t value);
+uint64_t readUint64(const unsigned char* buffer);
+
+
+// 								**** PIPELINE.C ****
+
+
+// Creates a ring of 'slotCount' buffers of 'slotSize' bytes, aligned for direct I/O
+BlockRing* createBlockRing(int slotCount, size_t slotSize);
+
+// Producer side: waits for a free slot and returns its buffer, then hands the oldest slot taken over
+// with the number of bytes in it. A buffer that cannot be allocated is returned as NULL and marks
+// the ring failed, the slot is taken all the same. NULL is also returned once the ring is stopping
+unsigned char* acquireFreeSlot(BlockRing* ring);
+void publishSlot(BlockRing* ring, size_t size);
+
+// Consumer side: waits for the next filled slot and returns its buffer and size, then gives back the
+// oldest slot taken. Once the ring is stopping, NULL is returned with a size of 0
+unsigned char* acquireFilledSlot(BlockRing* ring, size_t* size);
+void releaseSlot(BlockRing* ring);
+
+// Waits until the consumer has given back every slot handed over, called by the producer
+void drainBlockRing(BlockRing* ring);
+
+// Tells both sides to stop and wakes whichever is waiting for a slot
+void stopBlockRing(BlockRing* ring);
+
+// Frees the ring and its buffers, once neither thread uses it
+void freeBlockRing(BlockRing* ring);
+
+// Starts a thread reading 'fd' into a ring of 'slotCount' blocks of 'slotSize' bytes. Blocks hold what
+// one read returns, so pipes are passed on as data arrives, or are filled whole if 'whole'
+ReadAhead* startReadAhead(int fd, int slotCount, size_t slotSize, bool whole);
+
+// Gives back the block taken before, if any, and takes the next one. Returns its size, 0 at end of input
+size_t takeReadAhead(ReadAhead* readAhead);
+
+// Stops the reader thread, waiting for a slot or for input, and frees the ring. Returns false if a read failed
+bool stopReadAhead(ReadAhead* readAhead);
+
+
+// 								**** CODES.C ****
+
+
+// Creates the binary huffman tree from the frequency of every character, leaving frequencies unchanged
+Tree* createTree(Arena* arena, unsigned long* frequencies);
+
+// Fills a table indexed by character with the bit codes generated from tree
+void getBitEncodings(Tree* encodingTree, Code* codeTable);
+
+// Replaces the codes in the table with canonical codes of the same lengths
+void assignCanonicalCodes(Code* codeTable);
+
+// Builds canonical codes of at most 'lengthLimit' bits from character frequencies
+void buildCanonicalCodes(Arena* arena, unsigned long* frequencies, int lengthLimit, Code* codeTable);
+
+// Returns the largest number of bytes 'size' characters and a code length header can take
+size_t getCompressedBound(size_t size, int lengthLimit);
+
+// Returns the length of the longest code in the table
+int getMaxCodeLength(Code* codeTable);
+
+// Sets optimal code lengths of at most 'limit' bits using package-merge
+void limitCodeLengths(Arena* arena, unsigned long* frequencies, Code* codeTable, int limit);
+
+// Builds a Huffman tree that produces the codes in the table
+Tree* createTreeFromCodes(Arena* arena, Code* codeTable);
+
+// Writes the code length of every character that appears as a compact header
+void writeCodeLengths(BitWriter* writer, Code* codeTable);
+
+// Reads code lengths written by writeCodeLengths, returns false if header is invalid
+bool readCodeLengths(BitReader* reader, Code* codeTable);
+
+
+// 								**** INPUT.C ****
+
+
+// Maps a regular file into memory or reads any other file into the arena, NULL on error
+InputFile* openInput(Arena* arena, char* filename);
+
+// Releases the mapping of an input, if any
+void closeInput(InputFile* input);
+
+
+// 								**** OUTPUT.C ****
+
+
+// Creates or truncates a file for output, bypassing the page cache if 'direct' and the file system
+// allows it. NULL on error
+OutputFile* openOutput(Arena* arena, char* filename, bool direct);
+
+// Creates an output over a descriptor the caller keeps open, such as standard output. Returns NULL
+// if its first buffer cannot be allocated
+OutputFile* createOutput(Arena* arena, int fd, char* filename);
+
+// Copies 'size' bytes to the output, handing over every buffer that fills
+void writeOutput(OutputFile* output, const void* data, size_t size);
+
+// Hands the whole aligned blocks of the buffer to the writer thread and continues in the next
+// free buffer of the ring with the rest
+void submitOutput(OutputFile* output);
+
+// Writes everything buffered before returning, leaving direct mode. An unaligned rest is written
+// through the page cache and, for direct outputs, kept to be written again. Returns false if any write failed
+bool flushOutput(OutputFile* output);
+
+// Flushes and closes the output, returns false and reports an error if any write failed
+bool closeOutput(OutputFile* output);
+
+// Returns the number of bytes written to the output so far, buffered ones included
+uint64_t getOutputOffset(OutputFile* output);
+
+
+// 								**** HISTOGRAM.C ****
+
+
+// Adds the number of times every byte value appears in the data to frequencies[0 - 255]
+void countBytes(const unsigned char* data, size_t size, unsigned long* frequencies);
+
+
+// 								**** BATCH.C ****
+
+
+// Expands the arguments and the lines of 'listFilename', if given, into files. Directories are replaced
+// by the regular files anywhere below them, and the directories of every file are created under 'outputDirectory'
+char** collectFiles(Arena* arena, char** arguments, int argumentCount, char* listFilename, char* outputDirectory, int* fileCount);
+
+// Returns the path of the output of 'filename' under 'outputDirectory', ending in 'extension'. Leading
+// slashes and '.' or '..' components are dropped so the output cannot land outside the directory
+char* getOutputPath(Arena* arena, char* outputDirectory, char* filename, char* extension);
+
+// Processes every file on 'jobCount' workers and reports throughput and latency, returns false if any file failed
+bool runBatch(char** files, int fileCount, int jobCount, bool (*process)(Arena*, char*, void*), void* options);
+
+
+// 								**** STATS.C ****
+
+
+// Turns on --stats collection, warns if it was compiled out
+void enableStats();
+
+// Starts timing a stage on the calling thread
+void startStatsTimer(StatsTimer* timer);
+
+// Adds the time since the timer started to 'stage' and restarts the timer for the next stage
+void stopStatsTimer(StatsTimer* timer, int stage);
+
+// Adds to one of the STATS_ counters, safe from any thread
+void addStatsCount(int counter, uint64_t amount);
+
+// Adds the code lengths of a table to the code length histogram and tree depth
+void recordCodeLengths(Code* codeTable);
+
+// Prints stage times, counters and the code length histogram, if collection is on
+void printStats(FILE* out);
+
+
+// 								**** POOL.C ****
+
+
+// Starts a pool of worker threads
+ThreadPool* createThreadPool(int threadCount);
+
+// Queues a function to run on a worker, waiting if the queue is full
+void submitTask(ThreadPool* pool, void (*function)(void*), void* argument, bool* done);
+
+// Waits until the task with the given done flag has finished
+void waitForTask(ThreadPool* pool, bool* done);
+
+// Returns the number of processors available
+int getProcessorCount();
+
+// Runs the tasks left in the queue, then stops and frees the pool
+void freeThreadPool(ThreadPool* pool);
+
+
+// 								**** ARENA.C ****
+
+
+// Creates an arena that allocates system memory in blocks of at least 'blockSize' bytes
+Arena* createArena(size_t blockSize);
+
+// Returns 'size' bytes of uninitialized memory that live until the next reset
+void* arenaAlloc(Arena* arena, size_t size);
+
+// Resizes an allocation, in place if it was the most recent one
+void* arenaGrow(Arena* arena, void* memory, size_t oldSize, size_t newSize);
+
+// Releases every allocation at once. One block sized to what was used, up to ARENA_RETAIN_LIMIT, is kept for
+// the next file and the others are freed
+void resetArena(Arena* arena);
+
+// Prints allocations made since the last reset
+void printArenaUsage(Arena* arena, char* filename);
+
+void freeArena(Arena* arena);
 
 
 // 								**** HELPERS ****
 
 // Utility
 unsigned long getFileSize(FILE* fp);
-void swapFrequencies(unsigned long* x, unsigned long* y);
-void swapCharacters(int* x, int* y);
-int getMaxDepth(Node* node);
-void getCodes(Node* node, List* list, char* code, int index, int treeDepth);
-char* getBinary(Node* node);
+int getMaxDepth(Tree* tree, int node);
+void getCodes(Tree* tree, int node, Code* codeTable, uint64_t bits, int length);
 
 // Writing
-void writeCode(char* code, FILE* fp, int* byte, int* level);
-void encodeHeader(FILE* fp, Node* node, int* byte, int* level);
+void submitBlock(ThreadPool* pool, BlockJob* job, InputFile* original, uint32_t block, size_t blockSize);
 
 // Reading
-int readBit(FILE* fp, unsigned char* byte, int* level);
-int readByte(FILE* fp, unsigned char* byte, int* level);
-void skipByte(FILE* fp, unsigned char* byte, int* level);
+void submitSegment(ThreadPool* pool, DecodeJob* job, BlockEntry* block, uint32_t number);
+void decodeSegment(void* argument);
+uint32_t findBlock(BlockIndex* index, uint64_t offset);
+bool loadBlock(SeekableFile* file, uint32_t block);
+int fillDecodeTable(Arena* arena, DecodeTable* table, uint32_t offset, int width, int consumed, uint64_t prefix, Code* codeTable);
+void pairDecodeEntries(Arena* arena, DecodeTable* table);
+int reconstructNode(BitReader* reader, Tree* tree, int depth);
+
+// Histogram
+void countIntoTables(const unsigned char* data, size_t size, uint32_t (*counts)[256]);
+
+// Threading
+void* runWorker(void* argument);
+
+// Batches
+void submitFile(ThreadPool* pool, FileJob* job, char* filename);
+void processFile(void* argument);
+char** addFile(Arena* arena, char** files, int* fileCount, int* capacity, char* filename);
+char** addDirectory(Arena* arena, char** files, int* fileCount, int* capacity, char* directoryName);
+void createOutputDirectories(Arena* arena, char* outputDirectory, char* filename);
+void printBatchReport(double* latencies, int fileCount, uint64_t totalSize, double seconds);
+int compareLatencies(const void* x, const void* y);
+
+// Output
+void* runWriter(void* argument);
+bool writeAll(OutputFile* output, const unsigned char* data, size_t size);
+void setOutputDirect(OutputFile* output, bool direct);
+void attachOutput(BitWriter* writer);
+
+// Pipeline
+void* runReadAhead(void* argument);
+bool waitForInput(ReadAhead* readAhead);
+size_t takeReadAheadBlock(BitReader* reader);
+
+// Bulk encoding
+size_t encodeGroups(BitWriter* writer, uint32_t* packedCodes, int group, const unsigned char* data, size_t position, size_t size);
+
+// Context modelling
+void sumSharedCounts(unsigned long (*pairs)[ASCII_COUNT], bool* own, unsigned long* shared);
+double getContextCost(unsigned long* counts, unsigned long* model);
+double getTableCost(unsigned long* counts);
+
+// Library decoding
+int decompressWhole(HuffContext* context, BitReader* reader, int format, unsigned char* output, size_t capacity, size_t* outputSize);
+int decompressBufferBlocks(HuffContext* context, BitReader* reader, int format, const unsigned char* input, size_t inputSize,
+	unsigned char* output, size_t capacity, size_t* outputSize);
+int decompressBufferMessages(BitReader* reader, unsigned char* output, size_t capacity, size_t* outputSize);
+int decompressBufferContexts(HuffContext* context, BitReader* reader, unsigned char* output, size_t capacity, size_t* outputSize);
+int decompressBufferInterleaved(HuffContext* context, BitReader* reader, unsigned char* output, size_t capacity, size_t* outputSize);
+int decompressBufferRuns(const unsigned char* input, size_t inputSize, unsigned char* output, size_t capacity, size_t* outputSize);
+
+// Code generation
+int comparePackageItems(const void* x, const void* y);
+int compareNodes(const void* x, const void* y);
 
 // Data structure manipulation
-List* createList();
-Node* createNode(int value, unsigned long frequency);
-void append(List* list, Node* node);
-void insertNode(List* list, Node* node);
+Tree* createEmptyTree(Arena* arena);
+int addNode(Tree* tree, int value, unsigned long frequency, int leftChild, int rightChild);
 
 // Memory management functions
-void freeList(List* list);
-void freeTree(List* list);
-void freeTreeHelper(Node* node);
+ArenaBlock* addArenaBlock(Arena* arena, size_t size);
 
 // Debugging functions
 void printNode(Node* node);
 void printByte(int byte);
-void printList(List* list);
-void printTree(Node* node, int space);
+void printTree(Tree* tree, int node, int space);
 
 #endif // __huff_h_
@@ -0,0 +1,79 @@
+#include "huff.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+InputFile* openInput(Arena* arena, char* filename)
+{
+	// Open file in binary mode, error handle
+	int fd = open(filename, O_RDONLY);
+	if(fd == -1)
+	{
+		fprintf(stderr, "Cannot open %s\n", filename);
+		return NULL;
+	}
+
+	InputFile* input = arenaAlloc(arena, sizeof(*input));
+	input -> data = NULL;
+	input -> size = 0;
+	input -> mapped = false;
+
+	// Regular files are mapped and read sequentially straight from the page cache
+	struct stat status;
+	if(fstat(fd, &status) == 0 && S_ISREG(status.st_mode))
+	{
+		input -> size = status.st_size;
+		if(input -> size == 0)
+		{
+			close(fd);
+			return input;
+		}
+		void* data = mmap(NULL, input -> size, PROT_READ, MAP_PRIVATE, fd, 0);
+		STATS_ADD(STATS_MAP_CALLS, 1);
+		if(data != MAP_FAILED)
+		{
+			madvise(data, input -> size, MADV_SEQUENTIAL);
+			input -> data = data;
+			input -> mapped = true;
+			close(fd);
+			return input;
+		}
+	}
+
+	// Pipes and other files that cannot be mapped are read into memory in large blocks
+	size_t capacity = INPUT_READ_SIZE;
+	unsigned char* buffer = arenaAlloc(arena, capacity);
+	input -> size = 0;
+	ssize_t bytesRead;
+	while((bytesRead = read(fd, buffer + input -> size, capacity - input -> size)) > 0)
+	{
+		STATS_ADD(STATS_READ_CALLS, 1);
+		input -> size += bytesRead;
+		if(input -> size == capacity)
+		{
+			buffer = arenaGrow(arena, buffer, capacity, capacity * 2);
+			capacity *= 2;
+		}
+	}
+	close(fd);
+	if(bytesRead == -1)
+	{
+		fprintf(stderr, "ERROR: Cannot read %s\n", filename);
+		return NULL;
+	}
+	input -> data = buffer;
+	return input;
+}
+
+void closeInput(InputFile* input)
+{
+	// Read buffers belong to the arena, only mappings need releasing
+	if(input -> mapped)
+	{
+		munmap((void*)input -> data, input -> size);
+	}
+}
@@ -0,0 +1,562 @@
+#include "huff.h"
+#include "libhuff.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+HuffContext* huff_create_context(void)
+{
+	HuffContext* context = malloc(sizeof(*context));
+	context -> arena = createArena(ARENA_BLOCK_SIZE);
+	context -> blockArena = createArena(ARENA_BLOCK_SIZE);
+	context -> modelArena = createArena(ARENA_BLOCK_SIZE);
+	context -> model = NULL;
+	context -> lengthLimit = DEFAULT_CODE_LENGTH_LIMIT;
+	context -> order = 0;
+
+	return context;
+}
+
+// The public bounds must follow the codec's own
+_Static_assert(HUFF_MIN_MAX_LENGTH == MIN_CODE_LENGTH_LIMIT && HUFF_MAX_MAX_LENGTH == MAX_CODE_LENGTH, "libhuff.h length bounds are stale");
+
+int huff_set_max_length(HuffContext* context, int lengthLimit)
+{
+	if(lengthLimit < MIN_CODE_LENGTH_LIMIT || lengthLimit > MAX_CODE_LENGTH)
+	{
+		return HUFF_ERROR_INVALID_ARGUMENT;
+	}
+	context -> lengthLimit = lengthLimit;
+	return HUFF_OK;
+}
+
+int huff_set_order(HuffContext* context, int order)
+{
+	if(order != 0 && order != 1)
+	{
+		return HUFF_ERROR_INVALID_ARGUMENT;
+	}
+	context -> order = order;
+	return HUFF_OK;
+}
+
+int huff_set_model(HuffContext* context, const void* model, size_t modelSize)
+{
+	resetArena(context -> modelArena);
+	context -> model = NULL;
+	if(model == NULL)
+	{
+		return HUFF_OK;
+	}
+	context -> model = readModel(context -> modelArena, model, modelSize);
+	return context -> model != NULL ? HUFF_OK : HUFF_ERROR_INVALID_ARGUMENT;
+}
+
+size_t huff_compress_bound(const HuffContext* context, size_t size)
+{
+	// Format tag, then the largest code length header and every character at the longest length
+	int lengthLimit = context -> model != NULL ? getMaxCodeLength(context -> model -> codes) : context -> lengthLimit;
+	size_t bound = 1 + getCompressedBound(size, lengthLimit);
+
+	// Order-1 codes add a table for every context that appears and the list of those contexts
+	if(context -> model == NULL && context -> order == 1)
+	{
+		bound += (size < CONTEXT_COUNT ? size : CONTEXT_COUNT) * (size_t)CODE_LENGTHS_BOUND + CONTEXT_LIST_BOUND;
+	}
+	return bound;
+}
+
+int huff_compress(HuffContext* context, const void* input, size_t inputSize, void* output, size_t outputCapacity, size_t* outputSize)
+{
+	// Everything for one call comes from the context's arena
+	resetArena(context -> arena);
+	*outputSize = 0;
+
+	// Write straight into the caller's buffer when it can hold the worst case, otherwise into the arena
+	size_t bound = huff_compress_bound(context, inputSize);
+	BitWriter* writer = outputCapacity >= bound ? createBufferBitWriter(context -> arena, output, outputCapacity) :
+		createMemoryBitWriter(context -> arena, bound);
+
+	// A model's codes need no counting and only its identifier as header, output they do not shrink
+	// is stored below
+	Code* codeTable = NULL;
+	if(context -> model != NULL)
+	{
+		codeTable = context -> model -> codes;
+		writeBits(writer, FORMAT_MODEL, 8);
+		writeBits(writer, context -> model -> id, 32);
+	}
+	else
+	{
+		// Canonical codes from this buffer's own counts
+		unsigned long* frequencies = arenaAlloc(context -> arena, ASCII_COUNT * sizeof(*frequencies));
+		memset(frequencies, 0, ASCII_COUNT * sizeof(*frequencies));
+		countBytes(input, inputSize, frequencies);
+		frequencies[PSEUDO_EOF_VALUE] = PSEUDO_EOF_FREQUENCY;
+
+		// Buffers codes cannot shrink are stored, and those of few long runs kept as runs
+		int encoding = chooseEncoding(frequencies, input, inputSize);
+		ContextModel* contextModel = NULL;
+		if(context -> order == 1 && encoding != ENCODING_RUNS)
+		{
+			// Order-1 codes decide on storing themselves, they can shrink data whose characters alone look random
+			contextModel = buildContextModel(context -> arena, input, inputSize, context -> lengthLimit);
+			encoding = inputSize == 0 || contextModel -> bits / 8 >= inputSize ? ENCODING_STORED : ENCODING_HUFFMAN;
+		}
+		if(encoding == ENCODING_STORED)
+		{
+			writeBits(writer, FORMAT_STORED, 8);
+			writeBytes(writer, input, inputSize);
+		}
+		else if(encoding == ENCODING_RUNS)
+		{
+			unsigned char header[RUNS_HEADER_SIZE];
+			writeUint64(header, inputSize);
+			writeBits(writer, FORMAT_RUNS, 8);
+			writeBytes(writer, header, RUNS_HEADER_SIZE);
+			encodeRuns(writer, input, inputSize);
+		}
+		else if(contextModel != NULL)
+		{
+			writeBits(writer, FORMAT_CONTEXT, 8);
+			writeContextModel(writer, contextModel);
+			encodeContexts(writer, contextModel, input, inputSize);
+		}
+		else
+		{
+			codeTable = arenaAlloc(context -> arena, ASCII_COUNT * sizeof(*codeTable));
+			buildCanonicalCodes(context -> arena, frequencies, context -> lengthLimit, codeTable);
+			writeBits(writer, FORMAT_CANONICAL, 8);
+			writeCodeLengths(writer, codeTable);
+		}
+	}
+	if(codeTable != NULL)
+	{
+		encodeData(writer, codeTable, input, inputSize);
+		writeBits(writer, codeTable[PSEUDO_EOF_VALUE].bits, codeTable[PSEUDO_EOF_VALUE].length);
+	}
+	flushBitWriter(writer);
+
+	// Choices are made on a lower bound of the coded size, output that came out no smaller is stored instead
+	if(writer -> position >= 1 + inputSize && writer -> buffer[0] != FORMAT_STORED)
+	{
+		rewindBitWriter(writer);
+		writeBits(writer, FORMAT_STORED, 8);
+		writeBytes(writer, input, inputSize);
+		flushBitWriter(writer);
+	}
+
+	if(writer -> position > outputCapacity)
+	{
+		return HUFF_ERROR_OUTPUT_TOO_SMALL;
+	}
+	if(writer -> buffer != output)
+	{
+		memcpy(output, writer -> buffer, writer -> position);
+	}
+	*outputSize = writer -> position;
+	return HUFF_OK;
+}
+
+int huff_decompress(HuffContext* context, const void* input, size_t inputSize, void* output, size_t outputCapacity, size_t* outputSize)
+{
+	resetArena(context -> arena);
+	*outputSize = 0;
+	if(inputSize == 0)
+	{
+		return HUFF_ERROR_INVALID_INPUT;
+	}
+
+	// Every format is read front to back, the index of block formats only gives block sizes
+	BitReader* reader = createMemoryBitReader(context -> arena, input, inputSize);
+	int format = readFormat(reader);
+	if(format == FORMAT_TREE || format == FORMAT_CANONICAL)
+	{
+		return decompressWhole(context, reader, format, output, outputCapacity, outputSize);
+	}
+	else if(format == FORMAT_BLOCKS || format == FORMAT_SYNC || format == FORMAT_STREAM)
+	{
+		return decompressBufferBlocks(context, reader, format, input, inputSize, output, outputCapacity, outputSize);
+	}
+	else if(format == FORMAT_ADAPTIVE)
+	{
+		return decompressBufferMessages(reader, output, outputCapacity, outputSize);
+	}
+	else if(format == FORMAT_STORED)
+	{
+		// Stored data is everything after the tag
+		if(inputSize - 1 > outputCapacity)
+		{
+			return HUFF_ERROR_OUTPUT_TOO_SMALL;
+		}
+		memcpy(output, (const unsigned char*)input + 1, inputSize - 1);
+		*outputSize = inputSize - 1;
+		return HUFF_OK;
+	}
+	else if(format == FORMAT_RUNS)
+	{
+		return decompressBufferRuns(input, inputSize, output, outputCapacity, outputSize);
+	}
+	else if(format == FORMAT_INTERLEAVED)
+	{
+		return decompressBufferInterleaved(context, reader, output, outputCapacity, outputSize);
+	}
+	else if(format == FORMAT_CONTEXT)
+	{
+		return decompressBufferContexts(context, reader, output, outputCapacity, outputSize);
+	}
+	else if(format == FORMAT_MODEL)
+	{
+		// Data must have been compressed with the model that is set
+		if(context -> model == NULL || readBits(reader, 32) != context -> model -> id)
+		{
+			return HUFF_ERROR_WRONG_MODEL;
+		}
+		int result = decodeIntoBuffer(reader, context -> model -> table, output, outputCapacity, outputSize);
+		if(result == DECODE_FULL)
+		{
+			return HUFF_ERROR_OUTPUT_TOO_SMALL;
+		}
+		return result == DECODE_END ? HUFF_OK : HUFF_ERROR_INVALID_INPUT;
+	}
+	return HUFF_ERROR_UNKNOWN_FORMAT;
+}
+
+int decompressWhole(HuffContext* context, BitReader* reader, int format, unsigned char* output, size_t capacity, size_t* outputSize)
+{
+	// Rebuild the codes from the header, canonical headers need no tree
+	Code codeTable[ASCII_COUNT];
+	if(format == FORMAT_CANONICAL)
+	{
+		if(!readCodeLengths(reader, codeTable))
+		{
+			return HUFF_ERROR_INVALID_INPUT;
+		}
+		assignCanonicalCodes(codeTable);
+	}
+	else
+	{
+		Tree* tree = reconstructTree(context -> arena, reader);
+		if(tree == NULL)
+		{
+			return HUFF_ERROR_INVALID_INPUT;
+		}
+		getBitEncodings(tree, codeTable);
+	}
+
+	DecodeTable* table = buildDecodeTable(context -> arena, codeTable);
+	int result = decodeIntoBuffer(reader, table, output, capacity, outputSize);
+	if(result == DECODE_FULL)
+	{
+		return HUFF_ERROR_OUTPUT_TOO_SMALL;
+	}
+	return result == DECODE_END ? HUFF_OK : HUFF_ERROR_INVALID_INPUT;
+}
+
+int decompressBufferBlocks(HuffContext* context, BitReader* reader, int format, const unsigned char* input, size_t inputSize,
+	unsigned char* output, size_t capacity, size_t* outputSize)
+{
+	// Sync files share one table read from the padded header
+	DecodeTable* shared = NULL;
+	if(format == FORMAT_SYNC)
+	{
+		Code codeTable[ASCII_COUNT];
+		if(!readCodeLengths(reader, codeTable))
+		{
+			return HUFF_ERROR_INVALID_INPUT;
+		}
+		assignCanonicalCodes(codeTable);
+		shared = buildDecodeTable(context -> arena, codeTable);
+		alignToByte(reader);
+	}
+
+	// Indexed files give the block count and sizes in the footer, streams give sizes before each block
+	const unsigned char* entries = NULL;
+	uint32_t blockCount = UINT32_MAX;
+	if(format != FORMAT_STREAM)
+	{
+		if(inputSize < 1 + BLOCK_FOOTER_SIZE)
+		{
+			return HUFF_ERROR_INVALID_INPUT;
+		}
+		blockCount = readUint32(input + inputSize - 4);
+		if((uint64_t)blockCount * BLOCK_INDEX_ENTRY_SIZE > inputSize - 1 - BLOCK_FOOTER_SIZE)
+		{
+			return HUFF_ERROR_INVALID_INPUT;
+		}
+		entries = input + inputSize - BLOCK_FOOTER_SIZE - (size_t)blockCount * BLOCK_INDEX_ENTRY_SIZE;
+	}
+
+	// Indexed blocks must follow one another at the sizes the index gives, up to the index itself
+	uint64_t end = getReaderOffset(reader);
+	uint32_t block;
+	for(block = 0; block < blockCount; block++)
+	{
+		uint32_t originalSize;
+		if(entries != NULL)
+		{
+			end += readUint32(entries + block * BLOCK_INDEX_ENTRY_SIZE);
+			originalSize = readUint32(entries + block * BLOCK_INDEX_ENTRY_SIZE + 4);
+		}
+		else
+		{
+			unsigned char sizes[BLOCK_INDEX_ENTRY_SIZE];
+			if(readBytes(reader, sizes, BLOCK_INDEX_ENTRY_SIZE) != BLOCK_INDEX_ENTRY_SIZE)
+			{
+				return HUFF_ERROR_INVALID_INPUT;
+			}
+			originalSize = readUint32(sizes + 4);
+			if(readUint32(sizes) == 0 && originalSize == 0)
+			{
+				break;
+			}
+		}
+
+		// Stored and runs blocks go straight into the output
+		if(originalSize > capacity - *outputSize)
+		{
+			return HUFF_ERROR_OUTPUT_TOO_SMALL;
+		}
+		if(shared == NULL && isRawBlock(reader))
+		{
+			if(!decodeRawBlock(reader, output + *outputSize, originalSize) || (entries != NULL && getReaderOffset(reader) != end))
+			{
+				return HUFF_ERROR_INVALID_INPUT;
+			}
+			*outputSize += originalSize;
+			continue;
+		}
+
+		// Blocks without a shared table start with their own code lengths
+		DecodeTable* table = shared;
+		if(table == NULL)
+		{
+			Code codeTable[ASCII_COUNT];
+			resetArena(context -> blockArena);
+			if(!readCodeLengths(reader, codeTable))
+			{
+				return HUFF_ERROR_INVALID_INPUT;
+			}
+			assignCanonicalCodes(codeTable);
+			table = buildDecodeTable(context -> blockArena, codeTable);
+		}
+
+		// Every block must decode to exactly the size it was given
+		size_t length = 0;
+		if(decodeIntoBuffer(reader, table, output + *outputSize, originalSize, &length) != DECODE_END || length != originalSize)
+		{
+			return HUFF_ERROR_INVALID_INPUT;
+		}
+		*outputSize += length;
+		alignToByte(reader);
+		if(entries != NULL && getReaderOffset(reader) != end)
+		{
+			return HUFF_ERROR_INVALID_INPUT;
+		}
+	}
+	return entries == NULL || end == (uint64_t)(entries - input) ? HUFF_OK : HUFF_ERROR_INVALID_INPUT;
+}
+
+int decompressBufferInterleaved(HuffContext* context, BitReader* reader, unsigned char* output, size_t capacity, size_t* outputSize)
+{
+	Code codeTable[ASCII_COUNT];
+	if(!readCodeLengths(reader, codeTable))
+	{
+		return HUFF_ERROR_INVALID_INPUT;
+	}
+	assignCanonicalCodes(codeTable);
+	DecodeTable* table = createDecodeTable(context -> arena, codeTable);
+	alignToByte(reader);
+
+	// Streams are decoded where they are in the input, straight into the output
+	while(true)
+	{
+		unsigned char header[INTERLEAVE_HEADER_SIZE];
+		if(readBytes(reader, header, INTERLEAVE_HEADER_SIZE) != INTERLEAVE_HEADER_SIZE)
+		{
+			return HUFF_ERROR_INVALID_INPUT;
+		}
+		uint32_t size = readUint32(header);
+		if(size == 0)
+		{
+			return HUFF_OK;
+		}
+		uint32_t streamSizes[INTERLEAVE_STREAMS];
+		size_t total = 0;
+		int stream;
+		for(stream = 0; stream < INTERLEAVE_STREAMS; stream++)
+		{
+			streamSizes[stream] = readUint32(header + 4 + 4 * stream);
+			total += streamSizes[stream];
+		}
+		if(total > reader -> size - reader -> position)
+		{
+			return HUFF_ERROR_INVALID_INPUT;
+		}
+		if(size > capacity - *outputSize)
+		{
+			return HUFF_ERROR_OUTPUT_TOO_SMALL;
+		}
+		if(!decodeInterleaved(table, reader -> buffer + reader -> position, streamSizes, output + *outputSize, size))
+		{
+			return HUFF_ERROR_INVALID_INPUT;
+		}
+		reader -> position += total;
+		*outputSize += size;
+	}
+}
+
+int decompressBufferContexts(HuffContext* context, BitReader* reader, unsigned char* output, size_t capacity, size_t* outputSize)
+{
+	ContextModel* model = readContextModel(context -> arena, reader);
+	if(model == NULL)
+	{
+		return HUFF_ERROR_INVALID_INPUT;
+	}
+
+	// A full buffer is only too small if a character other than Pseudo-EOF follows
+	int result = decodeContexts(model, reader, output, capacity, outputSize);
+	if(result == DECODE_FULL)
+	{
+		unsigned char rest;
+		size_t count = 0;
+		result = decodeContexts(model, reader, &rest, 1, &count);
+		if(count > 0 && result != DECODE_TRUNCATED)
+		{
+			return HUFF_ERROR_OUTPUT_TOO_SMALL;
+		}
+	}
+	return result == DECODE_END ? HUFF_OK : HUFF_ERROR_INVALID_INPUT;
+}
+
+int decompressBufferRuns(const unsigned char* input, size_t inputSize, unsigned char* output, size_t capacity, size_t* outputSize)
+{
+	// Original size, then pairs of character and length fill the rest of the input
+	if(inputSize < 1 + RUNS_HEADER_SIZE || (inputSize - 1 - RUNS_HEADER_SIZE) % RUN_SIZE != 0)
+	{
+		return HUFF_ERROR_INVALID_INPUT;
+	}
+	uint64_t size = readUint64(input + 1);
+	if(size > capacity)
+	{
+		return HUFF_ERROR_OUTPUT_TOO_SMALL;
+	}
+
+	// Runs must add up to exactly the original size
+	const unsigned char* run;
+	for(run = input + 1 + RUNS_HEADER_SIZE; run < input + inputSize; run += RUN_SIZE)
+	{
+		uint32_t length = readUint32(run + 1);
+		if(length > size - *outputSize)
+		{
+			return HUFF_ERROR_INVALID_INPUT;
+		}
+		memset(output + *outputSize, run[0], length);
+		*outputSize += length;
+	}
+	return *outputSize == size ? HUFF_OK : HUFF_ERROR_INVALID_INPUT;
+}
+
+int decompressBufferMessages(BitReader* reader, unsigned char* output, size_t capacity, size_t* outputSize)
+{
+	// Code length limit, then messages decoded with the model carried from one to the next
+	unsigned char sizes[BLOCK_INDEX_ENTRY_SIZE];
+	if(readBytes(reader, sizes, 1) != 1 || sizes[0] < MIN_CODE_LENGTH_LIMIT || sizes[0] > MAX_CODE_LENGTH)
+	{
+		return HUFF_ERROR_INVALID_INPUT;
+	}
+	AdaptiveModel* model = createAdaptiveModel(sizes[0]);
+	model -> table = createDecodeTable(model -> arena, model -> codes);
+
+	int result = HUFF_OK;
+	while(result == HUFF_OK)
+	{
+		if(readBytes(reader, sizes, BLOCK_INDEX_ENTRY_SIZE) != BLOCK_INDEX_ENTRY_SIZE)
+		{
+			result = HUFF_ERROR_INVALID_INPUT;
+			break;
+		}
+		uint32_t originalSize = readUint32(sizes + 4);
+		if(readUint32(sizes) == 0 && originalSize == 0)
+		{
+			break;
+		}
+		if(originalSize > capacity - *outputSize)
+		{
+			result = HUFF_ERROR_OUTPUT_TOO_SMALL;
+		}
+		else if(!decodeAdaptive(model, reader, output + *outputSize, originalSize))
+		{
+			result = HUFF_ERROR_INVALID_INPUT;
+		}
+		else
+		{
+			*outputSize += originalSize;
+			alignToByte(reader);
+		}
+	}
+
+	freeAdaptiveModel(model);
+	return result;
+}
+
+const char* huff_error_string(int result)
+{
+	if(result == HUFF_OK)
+	{
+		return "success";
+	}
+	else if(result == HUFF_ERROR_OUTPUT_TOO_SMALL)
+	{
+		return "output buffer too small";
+	}
+	else if(result == HUFF_ERROR_INVALID_INPUT)
+	{
+		return "invalid compressed data";
+	}
+	else if(result == HUFF_ERROR_UNKNOWN_FORMAT)
+	{
+		return "unknown format";
+	}
+	else if(result == HUFF_ERROR_INVALID_ARGUMENT)
+	{
+		return "invalid argument";
+	}
+	else if(result == HUFF_ERROR_WRONG_MODEL)
+	{
+		return "compressed with another model";
+	}
+	return "unknown error";
+}
+
+void huff_free_context(HuffContext* context)
+{
+	freeArena(context -> modelArena);
+	freeArena(context -> blockArena);
+	freeArena(context -> arena);
+	free(context);
+}
+
+HuffRange* huff_open_range(const char* filename)
+{
+	SeekableFile* file = openSeekable((char*)filename);
+	if(file == NULL)
+	{
+		return NULL;
+	}
+	HuffRange* range = malloc(sizeof(*range));
+	range -> file = file;
+	return range;
+}
+
+int huff_read_range(HuffRange* range, uint64_t offset, size_t length, void* output, size_t* outputSize)
+{
+	// Only blocks overlapping the range are decoded, the last one stays cached for the next call
+	return readRange(range -> file, offset, length, output, outputSize) ? HUFF_OK : HUFF_ERROR_INVALID_INPUT;
+}
+
+void huff_close_range(HuffRange* range)
+{
+	closeSeekable(range -> file);
+	free(range);
+}
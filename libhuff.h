@@ -0,0 +1,77 @@
+#ifndef __libhuff_h_
+#define __libhuff_h_
+
+#include <stddef.h>
+#include <stdint.h>
+
+//_______________________________________________________________________________________
+// LIBHUFF
+
+/*
+ *
+ *	Buffer to buffer Huffman compression. A context holds the memory reused across calls
+ *	and must only be used by one thread at a time.
+ *
+ *	huff_compress writes the canonical .huff format, the context format at order 1, or the model
+ *	format once a model is set.
+ *	huff_decompress reads every format huff writes: tree, canonical, block, sync, stream,
+ *	adaptive, model, stored, runs, context and interleaved.
+ *	huff_open_range reads parts of a block or sync file without decoding the rest.
+ *
+ */
+
+// Results of library calls
+#define HUFF_OK 0
+#define HUFF_ERROR_OUTPUT_TOO_SMALL -1 // Output buffer cannot hold the result
+#define HUFF_ERROR_INVALID_INPUT -2 // Compressed data is damaged or truncated
+#define HUFF_ERROR_UNKNOWN_FORMAT -3 // Compressed data has an unknown format tag
+#define HUFF_ERROR_INVALID_ARGUMENT -4 // Setting is out of range
+#define HUFF_ERROR_WRONG_MODEL -5 // Compressed data needs a model other than the one set
+
+// Range of code length limits huff_set_max_length accepts
+#define HUFF_MIN_MAX_LENGTH 9
+#define HUFF_MAX_MAX_LENGTH 56
+
+typedef struct HuffContext HuffContext;
+
+// Creates a context with the default code length limit
+HuffContext* huff_create_context(void);
+
+// Limits the length of codes written by huff_compress, between HUFF_MIN_MAX_LENGTH and HUFF_MAX_MAX_LENGTH bits
+int huff_set_max_length(HuffContext* context, int lengthLimit);
+
+// Returns the largest size huff_compress can produce for 'size' bytes of input
+size_t huff_compress_bound(const HuffContext* context, size_t size);
+
+// Codes every character with codes picked by the character before when 'order' is 1, or with
+// one set of codes when it is 0. Order 1 compresses text better at a larger header
+int huff_set_order(HuffContext* context, int order);
+
+// Uses a model file written by huff --train for the following calls, NULL stops using one.
+// Compressed data then holds only the model's identifier in place of a header
+int huff_set_model(HuffContext* context, const void* model, size_t modelSize);
+
+// Compresses 'inputSize' bytes into 'output', which holds 'outputCapacity' bytes, setting 'outputSize'
+int huff_compress(HuffContext* context, const void* input, size_t inputSize, void* output, size_t outputCapacity, size_t* outputSize);
+
+// Decompresses 'inputSize' bytes into 'output', which holds 'outputCapacity' bytes, setting 'outputSize'
+int huff_decompress(HuffContext* context, const void* input, size_t inputSize, void* output, size_t outputCapacity, size_t* outputSize);
+
+// Returns a description of a result
+const char* huff_error_string(int result);
+
+void huff_free_context(HuffContext* context);
+
+typedef struct HuffRange HuffRange;
+
+// Opens a file written by huff with --block-size or --sync for reading ranges, NULL if it cannot be
+// read or has no block index
+HuffRange* huff_open_range(const char* filename);
+
+// Copies up to 'length' bytes of the original file starting at 'offset' into 'output', setting 'outputSize',
+// which is less than 'length' only when the range passes the end of the file
+int huff_read_range(HuffRange* range, uint64_t offset, size_t length, void* output, size_t* outputSize);
+
+void huff_close_range(HuffRange* range);
+
+#endif
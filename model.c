@@ -0,0 +1,89 @@
+#include "huff.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+Model* trainModel(Arena* arena, unsigned long* frequencies, int lengthLimit)
+{
+	// Every character gets a code, even those the samples never contain
+	unsigned long counts[ASCII_COUNT];
+	int i;
+	for(i = 0; i < PSEUDO_EOF_VALUE; i++)
+	{
+		counts[i] = frequencies[i] + 1;
+	}
+	counts[PSEUDO_EOF_VALUE] = PSEUDO_EOF_FREQUENCY;
+
+	Model* model = arenaAlloc(arena, sizeof(*model));
+	buildCanonicalCodes(arena, counts, lengthLimit, model -> codes);
+	model -> id = getModelId(model -> codes);
+	model -> table = NULL;
+	return model;
+}
+
+uint32_t getModelId(Code* codeTable)
+{
+	// FNV-1a hash of the code lengths, which fully determine the codes
+	uint32_t hash = 2166136261u;
+	int i;
+	for(i = 0; i < ASCII_COUNT; i++)
+	{
+		hash = (hash ^ (uint32_t)codeTable[i].length) * 16777619u;
+	}
+	return hash;
+}
+
+size_t writeModel(Arena* arena, Model* model, unsigned char** data)
+{
+	// Magic, identifier, then code lengths in the same form as a canonical header
+	BitWriter* writer = createMemoryBitWriter(arena, MODEL_HEADER_SIZE + CODE_LENGTHS_BOUND);
+	writeBits(writer, MODEL_MAGIC, 32);
+	writeBits(writer, model -> id, 32);
+	writeCodeLengths(writer, model -> codes);
+	flushBitWriter(writer);
+
+	*data = writer -> buffer;
+	return writer -> position;
+}
+
+Model* readModel(Arena* arena, const unsigned char* data, size_t size)
+{
+	if(size < MODEL_HEADER_SIZE || readUint32(data) != MODEL_MAGIC)
+	{
+		return NULL;
+	}
+
+	// Identifier must match the code lengths it was written with
+	Model* model = arenaAlloc(arena, sizeof(*model));
+	model -> id = readUint32(data + 4);
+	BitReader* reader = createMemoryBitReader(arena, data + MODEL_HEADER_SIZE, size - MODEL_HEADER_SIZE);
+	if(!readCodeLengths(reader, model -> codes) || reader -> overrun > 8 || getModelId(model -> codes) != model -> id)
+	{
+		return NULL;
+	}
+	assignCanonicalCodes(model -> codes);
+
+	// Table is built once and shared by every file decoded with the model
+	model -> table = buildDecodeTable(arena, model -> codes);
+	return model;
+}
+
+Model* loadModel(Arena* arena, char* filename)
+{
+	FILE* fp = fopen(filename, "rb");
+	if(fp == NULL)
+	{
+		fprintf(stderr, "Cannot open %s\n", filename);
+		return NULL;
+	}
+	unsigned char* data = arenaAlloc(arena, MODEL_HEADER_SIZE + CODE_LENGTHS_BOUND);
+	size_t size = fread(data, 1, MODEL_HEADER_SIZE + CODE_LENGTHS_BOUND, fp);
+	fclose(fp);
+
+	Model* model = readModel(arena, data, size);
+	if(model == NULL)
+	{
+		fprintf(stderr, "ERROR: %s is not a valid model.\n", filename);
+	}
+	return model;
+}
@@ -0,0 +1,235 @@
+#define _GNU_SOURCE
+#include "huff.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+OutputFile* openOutput(Arena* arena, char* filename, bool direct)
+{
+	int fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+	if(fd == -1)
+	{
+		fprintf(stderr, "Cannot open %s\n", filename);
+		return NULL;
+	}
+	OutputFile* output = createOutput(arena, fd, filename);
+	if(output == NULL)
+	{
+		close(fd);
+		return NULL;
+	}
+	output -> owned = true;
+
+	// File systems without direct I/O refuse the flag, those files go through the page cache
+	if(direct)
+	{
+		setOutputDirect(output, true);
+		output -> directWanted = output -> direct;
+	}
+	return output;
+}
+
+OutputFile* createOutput(Arena* arena, int fd, char* filename)
+{
+	// Fill the first buffer of the ring, small outputs never need another buffer or the writer thread
+	OutputFile* output = arenaAlloc(arena, sizeof(*output));
+	output -> fd = fd;
+	output -> filename = filename;
+	output -> owned = false;
+	output -> direct = false;
+	output -> directWanted = false;
+	output -> failed = false;
+	output -> ring = createBlockRing(OUTPUT_BUFFER_COUNT, OUTPUT_BUFFER_SIZE);
+	output -> buffer = acquireFreeSlot(output -> ring);
+	if(output -> buffer == NULL)
+	{
+		fprintf(stderr, "Cannot allocate output buffers for %s\n", filename);
+		freeBlockRing(output -> ring);
+		return NULL;
+	}
+	output -> capacity = OUTPUT_BUFFER_SIZE;
+	output -> position = 0;
+	output -> offset = 0;
+	output -> written = 0;
+	output -> started = false;
+
+	return output;
+}
+
+void writeOutput(OutputFile* output, const void* data, size_t size)
+{
+	const unsigned char* bytes = data;
+	while(size > 0)
+	{
+		size_t chunk = output -> capacity - output -> position < size ? output -> capacity - output -> position : size;
+		memcpy(output -> buffer + output -> position, bytes, chunk);
+		output -> position += chunk;
+		bytes += chunk;
+		size -= chunk;
+		if(output -> position == output -> capacity)
+		{
+			submitOutput(output);
+		}
+	}
+}
+
+void submitOutput(OutputFile* output)
+{
+	// Only whole aligned blocks are written, so every write but the last suits direct I/O
+	size_t size = output -> position & ~(size_t)(OUTPUT_ALIGNMENT - 1);
+	if(size == 0)
+	{
+		return;
+	}
+
+	// Once a buffer could not be allocated the output has failed, what would fill it is dropped
+	if(output -> ring -> failed)
+	{
+		output -> position = 0;
+		return;
+	}
+
+	// The next buffer is free once the writer thread is done with it, which only waits when the disk is behind
+	if(!output -> started)
+	{
+		pthread_create(&output -> thread, NULL, runWriter, output);
+		output -> started = true;
+	}
+	unsigned char* next = acquireFreeSlot(output -> ring);
+	if(next == NULL)
+	{
+		output -> failed = true;
+		output -> position = 0;
+		return;
+	}
+	memcpy(next, output -> buffer + size, output -> position - size);
+	publishSlot(output -> ring, size);
+	output -> buffer = next;
+	output -> position -= size;
+	output -> offset += size;
+}
+
+bool flushOutput(OutputFile* output)
+{
+	// Once the writer thread is done, whole blocks are written directly and the rest through the page cache
+	drainBlockRing(output -> ring);
+	size_t size = output -> position & ~(size_t)(OUTPUT_ALIGNMENT - 1);
+	size_t rest = output -> position - size;
+	if(!writeAll(output, output -> buffer, size) || !writeAll(output, output -> buffer + size, rest))
+	{
+		output -> failed = true;
+	}
+
+	// A direct output keeps the rest and writes its block again, so later writes stay aligned
+	if(output -> directWanted && rest > 0 && !output -> failed && lseek(output -> fd, -(off_t)rest, SEEK_CUR) != -1)
+	{
+		memmove(output -> buffer, output -> buffer + size, rest);
+		output -> written -= rest;
+		output -> offset += size;
+		output -> position = rest;
+	}
+	else
+	{
+		output -> directWanted = output -> directWanted && rest == 0;
+		output -> offset += output -> position;
+		output -> position = 0;
+	}
+
+	// Callers may write to the descriptor themselves, anywhere
+	setOutputDirect(output, false);
+	return !output -> failed;
+}
+
+bool closeOutput(OutputFile* output)
+{
+	// An empty buffer tells the writer thread to stop
+	bool success = flushOutput(output);
+	if(output -> started)
+	{
+		publishSlot(output -> ring, 0);
+		pthread_join(output -> thread, NULL);
+	}
+	freeBlockRing(output -> ring);
+	if(output -> owned)
+	{
+		success = (close(output -> fd) == 0) && success;
+	}
+	if(!success)
+	{
+		fprintf(stderr, "ERROR: Cannot write %s\n", output -> filename);
+	}
+	return success;
+}
+
+uint64_t getOutputOffset(OutputFile* output)
+{
+	return output -> offset + output -> position;
+}
+
+void* runWriter(void* argument)
+{
+	// Write buffers in the order they were handed over until the empty one
+	OutputFile* output = argument;
+	while(true)
+	{
+		size_t size;
+		unsigned char* buffer = acquireFilledSlot(output -> ring, &size);
+		if(size == 0)
+		{
+			break;
+		}
+		if(!writeAll(output, buffer, size))
+		{
+			output -> failed = true;
+		}
+		releaseSlot(output -> ring);
+	}
+	return NULL;
+}
+
+bool writeAll(OutputFile* output, const unsigned char* data, size_t size)
+{
+	while(size > 0)
+	{
+		// Direct I/O needs an aligned offset and length, anything else is written cached
+		setOutputDirect(output, output -> directWanted && output -> written % OUTPUT_ALIGNMENT == 0 && size % OUTPUT_ALIGNMENT == 0 &&
+			(uintptr_t)data % OUTPUT_ALIGNMENT == 0);
+		ssize_t bytes = write(output -> fd, data, size);
+		STATS_ADD(STATS_WRITE_CALLS, 1);
+
+		// A direct write the file system turns down is retried cached, as are all writes after it
+		if(bytes == -1 && errno == EINVAL && output -> direct)
+		{
+			output -> directWanted = false;
+			setOutputDirect(output, false);
+			continue;
+		}
+		if(bytes == -1 && errno == EINTR)
+		{
+			continue;
+		}
+		if(bytes <= 0)
+		{
+			return false;
+		}
+		data += bytes;
+		size -= bytes;
+		output -> written += bytes;
+	}
+	return true;
+}
+
+void setOutputDirect(OutputFile* output, bool direct)
+{
+	if(output -> direct == direct)
+	{
+		return;
+	}
+	// Turning it off only drops the flag, so a refused direct write is never retried as one
+	int flags = fcntl(output -> fd, F_GETFL);
+	bool changed = flags != -1 && fcntl(output -> fd, F_SETFL, direct ? flags | O_DIRECT : flags & ~O_DIRECT) == 0;
+	output -> direct = direct && changed;
+}
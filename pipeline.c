@@ -0,0 +1,235 @@
+#include "huff.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+
+BlockRing* createBlockRing(int slotCount, size_t slotSize)
+{
+	// Every slot starts free for the producer, its buffer is allocated the first time it is filled
+	BlockRing* ring = malloc(sizeof(*ring));
+	ring -> buffers = malloc(sizeof(*ring -> buffers) * slotCount);
+	ring -> sizes = malloc(sizeof(*ring -> sizes) * slotCount);
+	ring -> slotCount = slotCount;
+	ring -> slotSize = slotSize;
+	int i;
+	for(i = 0; i < slotCount; i++)
+	{
+		ring -> buffers[i] = NULL;
+		ring -> sizes[i] = 0;
+	}
+	ring -> acquired = 0;
+	ring -> published = 0;
+	ring -> taken = 0;
+	ring -> failed = false;
+	ring -> stopping = false;
+	sem_init(&ring -> free, 0, slotCount);
+	sem_init(&ring -> filled, 0, 0);
+
+	return ring;
+}
+
+unsigned char* acquireFreeSlot(BlockRing* ring)
+{
+	// Short inputs and outputs never go round the ring, so they only ever allocate the first buffer
+	sem_wait(&ring -> free);
+	if(__atomic_load_n(&ring -> stopping, __ATOMIC_ACQUIRE))
+	{
+		return NULL;
+	}
+	unsigned char** buffer = &ring -> buffers[ring -> acquired++ % ring -> slotCount];
+	if(*buffer == NULL)
+	{
+		*buffer = aligned_alloc(OUTPUT_ALIGNMENT, (ring -> slotSize + OUTPUT_ALIGNMENT - 1) & ~(size_t)(OUTPUT_ALIGNMENT - 1));
+		ring -> failed = ring -> failed || *buffer == NULL;
+	}
+	return *buffer;
+}
+
+void publishSlot(BlockRing* ring, size_t size)
+{
+	// Posting the semaphore makes the slot's contents visible to the consumer
+	ring -> sizes[ring -> published++ % ring -> slotCount] = size;
+	sem_post(&ring -> filled);
+}
+
+unsigned char* acquireFilledSlot(BlockRing* ring, size_t* size)
+{
+	sem_wait(&ring -> filled);
+	if(__atomic_load_n(&ring -> stopping, __ATOMIC_ACQUIRE))
+	{
+		*size = 0;
+		return NULL;
+	}
+	int slot = ring -> taken++ % ring -> slotCount;
+	*size = ring -> sizes[slot];
+	return ring -> buffers[slot];
+}
+
+void releaseSlot(BlockRing* ring)
+{
+	sem_post(&ring -> free);
+}
+
+void drainBlockRing(BlockRing* ring)
+{
+	// Every slot not held by the producer is free once the consumer is done, take them all and give them back
+	int held = ring -> acquired - ring -> published;
+	int i;
+	for(i = held; i < ring -> slotCount; i++)
+	{
+		sem_wait(&ring -> free);
+	}
+	for(i = held; i < ring -> slotCount; i++)
+	{
+		sem_post(&ring -> free);
+	}
+}
+
+void stopBlockRing(BlockRing* ring)
+{
+	// A side waiting on either semaphore wakes to find the flag set, one that is not sees it next time
+	__atomic_store_n(&ring -> stopping, true, __ATOMIC_RELEASE);
+	sem_post(&ring -> free);
+	sem_post(&ring -> filled);
+}
+
+void freeBlockRing(BlockRing* ring)
+{
+	int i;
+	for(i = 0; i < ring -> slotCount; i++)
+	{
+		free(ring -> buffers[i]);
+	}
+	sem_destroy(&ring -> free);
+	sem_destroy(&ring -> filled);
+	free(ring -> buffers);
+	free(ring -> sizes);
+	free(ring);
+}
+
+ReadAhead* startReadAhead(int fd, int slotCount, size_t slotSize, bool whole)
+{
+	ReadAhead* readAhead = malloc(sizeof(*readAhead));
+	readAhead -> fd = fd;
+	readAhead -> ring = createBlockRing(slotCount, slotSize);
+	readAhead -> whole = whole;
+	readAhead -> failed = false;
+	readAhead -> block = NULL;
+	readAhead -> holding = false;
+	readAhead -> ended = false;
+	if(pipe(readAhead -> wake) != 0)
+	{
+		readAhead -> wake[0] = -1;
+		readAhead -> wake[1] = -1;
+	}
+	pthread_create(&readAhead -> thread, NULL, runReadAhead, readAhead);
+
+	return readAhead;
+}
+
+size_t takeReadAhead(ReadAhead* readAhead)
+{
+	// The empty block at the end stays held, every later call ends there too
+	if(readAhead -> ended)
+	{
+		return 0;
+	}
+	if(readAhead -> holding)
+	{
+		releaseSlot(readAhead -> ring);
+	}
+	size_t size;
+	readAhead -> block = acquireFilledSlot(readAhead -> ring, &size);
+	readAhead -> holding = true;
+	readAhead -> ended = (size == 0);
+	return size;
+}
+
+bool stopReadAhead(ReadAhead* readAhead)
+{
+	// The thread may be waiting for a free slot or for input that never comes, wake it from both
+	stopBlockRing(readAhead -> ring);
+	if(readAhead -> wake[1] != -1)
+	{
+		unsigned char byte = 0;
+		while(write(readAhead -> wake[1], &byte, 1) == -1 && errno == EINTR);
+	}
+	pthread_join(readAhead -> thread, NULL);
+	if(readAhead -> wake[0] != -1)
+	{
+		close(readAhead -> wake[0]);
+		close(readAhead -> wake[1]);
+	}
+	bool success = !readAhead -> failed;
+	freeBlockRing(readAhead -> ring);
+	free(readAhead);
+	return success;
+}
+
+void* runReadAhead(void* argument)
+{
+	ReadAhead* readAhead = argument;
+	BlockRing* ring = readAhead -> ring;
+	bool ended = false;
+	while(!ended)
+	{
+		// Read until something arrives, or the block is full when whole blocks are wanted
+		// Without memory for the block the input ends here, as if a read had failed
+		unsigned char* block = acquireFreeSlot(ring);
+		if(__atomic_load_n(&ring -> stopping, __ATOMIC_ACQUIRE))
+		{
+			return NULL;
+		}
+		size_t size = 0;
+		if(block == NULL)
+		{
+			readAhead -> failed = true;
+			ended = true;
+		}
+		while(!ended && (size == 0 || (readAhead -> whole && size < ring -> slotSize)))
+		{
+			// Wait for input or for the consumer to stop, whichever comes first
+			if(!waitForInput(readAhead))
+			{
+				return NULL;
+			}
+			ssize_t bytes = read(readAhead -> fd, block + size, ring -> slotSize - size);
+			STATS_ADD(STATS_READ_CALLS, 1);
+			if(bytes == -1 && errno == EINTR)
+			{
+				continue;
+			}
+			readAhead -> failed = readAhead -> failed || bytes == -1;
+			ended = (bytes <= 0);
+			size += bytes > 0 ? bytes : 0;
+		}
+		publishSlot(ring, size);
+
+		// A block cut short by the end is followed by the empty one that marks it
+		if(ended && size > 0)
+		{
+			acquireFreeSlot(ring);
+			if(__atomic_load_n(&ring -> stopping, __ATOMIC_ACQUIRE))
+			{
+				return NULL;
+			}
+			publishSlot(ring, 0);
+		}
+	}
+	return NULL;
+}
+
+bool waitForInput(ReadAhead* readAhead)
+{
+	// Without the pipe only a read ends the wait, as input or its end arrives
+	if(readAhead -> wake[0] == -1)
+	{
+		return true;
+	}
+	struct pollfd descriptors[2] = {{readAhead -> fd, POLLIN, 0}, {readAhead -> wake[0], POLLIN, 0}};
+	while(poll(descriptors, 2, -1) == -1 && errno == EINTR);
+	return descriptors[1].revents == 0;
+}
@@ -0,0 +1,129 @@
+#include "huff.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+ThreadPool* createThreadPool(int threadCount)
+{
+	// Initialize empty task queue
+	ThreadPool* pool = malloc(sizeof(*pool));
+	pool -> threadCount = threadCount;
+	pool -> capacity = threadCount * 4;
+	pool -> tasks = malloc(sizeof(*pool -> tasks) * pool -> capacity);
+	pool -> head = 0;
+	pool -> count = 0;
+	pool -> stopping = false;
+	pthread_mutex_init(&pool -> lock, NULL);
+	pthread_cond_init(&pool -> available, NULL);
+	pthread_cond_init(&pool -> finished, NULL);
+
+	// Start workers, they wait until tasks are submitted
+	pool -> threads = malloc(sizeof(*pool -> threads) * threadCount);
+	int i;
+	for(i = 0; i < threadCount; i++)
+	{
+		pthread_create(&pool -> threads[i], NULL, runWorker, pool);
+	}
+
+	return pool;
+}
+
+void submitTask(ThreadPool* pool, void (*function)(void*), void* argument, bool* done)
+{
+	pthread_mutex_lock(&pool -> lock);
+
+	// Wait for room in the queue
+	while(pool -> count == pool -> capacity)
+	{
+		pthread_cond_wait(&pool -> finished, &pool -> lock);
+	}
+
+	// Add task to the back of the queue and wake a worker
+	Task* task = &pool -> tasks[(pool -> head + pool -> count) % pool -> capacity];
+	task -> function = function;
+	task -> argument = argument;
+	task -> done = done;
+	if(done != NULL)
+	{
+		*done = false;
+	}
+	pool -> count++;
+	pthread_cond_signal(&pool -> available);
+
+	pthread_mutex_unlock(&pool -> lock);
+}
+
+void waitForTask(ThreadPool* pool, bool* done)
+{
+	pthread_mutex_lock(&pool -> lock);
+	while(!*done)
+	{
+		pthread_cond_wait(&pool -> finished, &pool -> lock);
+	}
+	pthread_mutex_unlock(&pool -> lock);
+}
+
+void* runWorker(void* argument)
+{
+	ThreadPool* pool = argument;
+	pthread_mutex_lock(&pool -> lock);
+	while(true)
+	{
+		// Sleep until there is a task or the pool is shutting down
+		while(pool -> count == 0 && !pool -> stopping)
+		{
+			pthread_cond_wait(&pool -> available, &pool -> lock);
+		}
+		if(pool -> count == 0)
+		{
+			break;
+		}
+
+		// Take the task at the front of the queue and run it without holding the lock
+		Task task = pool -> tasks[pool -> head];
+		pool -> head = (pool -> head + 1) % pool -> capacity;
+		pool -> count--;
+		pthread_cond_broadcast(&pool -> finished);
+		pthread_mutex_unlock(&pool -> lock);
+
+		task.function(task.argument);
+
+		// Mark task as done and wake anyone waiting on it
+		pthread_mutex_lock(&pool -> lock);
+		if(task.done != NULL)
+		{
+			*task.done = true;
+		}
+		pthread_cond_broadcast(&pool -> finished);
+	}
+	pthread_mutex_unlock(&pool -> lock);
+	return NULL;
+}
+
+int getProcessorCount()
+{
+	long count = sysconf(_SC_NPROCESSORS_ONLN);
+	return count > 0 ? (int)count : 1;
+}
+
+void freeThreadPool(ThreadPool* pool)
+{
+	// Let workers finish the queue, then stop them
+	pthread_mutex_lock(&pool -> lock);
+	pool -> stopping = true;
+	pthread_cond_broadcast(&pool -> available);
+	pthread_mutex_unlock(&pool -> lock);
+
+	int i;
+	for(i = 0; i < pool -> threadCount; i++)
+	{
+		pthread_join(pool -> threads[i], NULL);
+	}
+
+	pthread_mutex_destroy(&pool -> lock);
+	pthread_cond_destroy(&pool -> available);
+	pthread_cond_destroy(&pool -> finished);
+	free(pool -> threads);
+	free(pool -> tasks);
+	free(pool);
+}
@@ -0,0 +1,143 @@
+#include "huff.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+SeekableFile* openSeekable(char* filename)
+{
+	FILE* fp = fopen(filename, "rb");
+	if(fp == NULL)
+	{
+		fprintf(stderr, "Cannot open %s\n", filename);
+		return NULL;
+	}
+	Arena* arena = createArena(ARENA_BLOCK_SIZE);
+	SeekableFile* file = arenaAlloc(arena, sizeof(*file));
+	file -> fp = fp;
+	file -> arena = arena;
+	file -> table = NULL;
+	file -> filename = filename;
+	file -> cachedBlock = -1;
+	file -> cachedData = NULL;
+
+	// Block files start right after the tag, sync files share one table after their header
+	BitReader* reader = createBitReader(arena, fp);
+	int format = readFormat(reader);
+	uint64_t firstOffset = 1;
+	if(format == FORMAT_SYNC)
+	{
+		Code codeTable[ASCII_COUNT];
+		if(!readCodeLengths(reader, codeTable))
+		{
+			fprintf(stderr, "ERROR: %s has an invalid header.\n", filename);
+			fclose(fp);
+			freeArena(arena);
+			return NULL;
+		}
+		assignCanonicalCodes(codeTable);
+		file -> table = buildDecodeTable(arena, codeTable);
+		alignToByte(reader);
+		firstOffset = getReaderOffset(reader);
+	}
+	else if(format != FORMAT_BLOCKS)
+	{
+		fprintf(stderr, "ERROR: %s has no block index, compress it with --block-size or --sync.\n", filename);
+		fclose(fp);
+		freeArena(arena);
+		return NULL;
+	}
+
+	file -> index = readBlockIndex(arena, fp, firstOffset);
+	if(file -> index == NULL)
+	{
+		fprintf(stderr, "ERROR: %s has an invalid block index.\n", filename);
+		fclose(fp);
+		freeArena(arena);
+		return NULL;
+	}
+
+	// Decoded blocks live in their own arena, reset whenever another block is loaded
+	file -> blockArena = createArena(ARENA_BLOCK_SIZE);
+	return file;
+}
+
+bool readRange(SeekableFile* file, uint64_t offset, size_t length, unsigned char* output, size_t* copied)
+{
+	// Nothing past the end of the original file
+	*copied = 0;
+	uint64_t originalSize = file -> index -> originalSize;
+	if(offset >= originalSize)
+	{
+		return true;
+	}
+	if(length > originalSize - offset)
+	{
+		length = originalSize - offset;
+	}
+
+	// Decode only the blocks that overlap the range, copying the overlapping part of each
+	uint32_t block = findBlock(file -> index, offset);
+	while(*copied < length)
+	{
+		if(!loadBlock(file, block))
+		{
+			return false;
+		}
+		BlockEntry* entry = &file -> index -> blocks[block];
+		size_t start = offset + *copied - entry -> originalOffset;
+		size_t count = entry -> originalSize - start;
+		if(count > length - *copied)
+		{
+			count = length - *copied;
+		}
+		memcpy(output + *copied, file -> cachedData + start, count);
+		*copied += count;
+		block++;
+	}
+	return true;
+}
+
+uint32_t findBlock(BlockIndex* index, uint64_t offset)
+{
+	// Last block that starts at or before the offset
+	uint32_t low = 0;
+	uint32_t high = index -> blockCount - 1;
+	while(low < high)
+	{
+		uint32_t middle = low + (high - low + 1) / 2;
+		if(index -> blocks[middle].originalOffset <= offset)
+		{
+			low = middle;
+		}
+		else
+		{
+			high = middle - 1;
+		}
+	}
+	return low;
+}
+
+bool loadBlock(SeekableFile* file, uint32_t block)
+{
+	// Consecutive reads from one block decode it only once
+	if(file -> cachedBlock == (int64_t)block)
+	{
+		return true;
+	}
+	resetArena(file -> blockArena);
+	file -> cachedBlock = -1;
+	file -> cachedData = decodeBlock(file -> blockArena, fileno(file -> fp), &file -> index -> blocks[block], file -> table, block, file -> filename);
+	if(file -> cachedData == NULL)
+	{
+		return false;
+	}
+	file -> cachedBlock = block;
+	return true;
+}
+
+void closeSeekable(SeekableFile* file)
+{
+	fclose(file -> fp);
+	freeArena(file -> blockArena);
+	freeArena(file -> arena);
+}
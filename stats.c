@@ -0,0 +1,128 @@
+#include "huff.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static const char* STATS_STAGE_NAMES[STATS_STAGE_COUNT] = {"input", "frequency", "tree", "codes", "encode", "header", "table", "decode"};
+
+// Totals over every file, stage times are added under the lock and counters atomically
+static bool statsEnabled = false;
+static pthread_mutex_t statsLock = PTHREAD_MUTEX_INITIALIZER;
+static double stageWallSeconds[STATS_STAGE_COUNT];
+static double stageCpuSeconds[STATS_STAGE_COUNT];
+static uint64_t stageCalls[STATS_STAGE_COUNT];
+static uint64_t statsCounters[STATS_COUNTER_COUNT];
+static uint64_t lengthCounts[MAX_CODE_LENGTH + 1];
+static int treeDepth = 0;
+
+void enableStats()
+{
+#ifdef HUFF_STATS
+	statsEnabled = true;
+#else
+	fprintf(stderr, "Built without HUFF_STATS, --stats has no effect.\n");
+#endif
+}
+
+void startStatsTimer(StatsTimer* timer)
+{
+	if(statsEnabled)
+	{
+		clock_gettime(CLOCK_MONOTONIC, &timer -> wall);
+		clock_gettime(CLOCK_THREAD_CPUTIME_ID, &timer -> cpu);
+	}
+}
+
+void stopStatsTimer(StatsTimer* timer, int stage)
+{
+	if(!statsEnabled)
+	{
+		return;
+	}
+
+	// CPU time is that of the calling thread, so work handed to a pool shows as wall time only
+	struct timespec wall;
+	struct timespec cpu;
+	clock_gettime(CLOCK_MONOTONIC, &wall);
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu);
+	pthread_mutex_lock(&statsLock);
+	stageWallSeconds[stage] += (wall.tv_sec - timer -> wall.tv_sec) + (wall.tv_nsec - timer -> wall.tv_nsec) / 1e9;
+	stageCpuSeconds[stage] += (cpu.tv_sec - timer -> cpu.tv_sec) + (cpu.tv_nsec - timer -> cpu.tv_nsec) / 1e9;
+	stageCalls[stage]++;
+	pthread_mutex_unlock(&statsLock);
+
+	// Next stage starts where this one ended
+	timer -> wall = wall;
+	timer -> cpu = cpu;
+}
+
+void addStatsCount(int counter, uint64_t amount)
+{
+	if(statsEnabled)
+	{
+		__atomic_fetch_add(&statsCounters[counter], amount, __ATOMIC_RELAXED);
+	}
+}
+
+void recordCodeLengths(Code* codeTable)
+{
+	if(!statsEnabled)
+	{
+		return;
+	}
+	pthread_mutex_lock(&statsLock);
+	int i;
+	for(i = 0; i < ASCII_COUNT; i++)
+	{
+		// Lengths past the longest code only come from damaged headers, they share the last bucket
+		int length = codeTable[i].length < MAX_CODE_LENGTH ? codeTable[i].length : MAX_CODE_LENGTH;
+		lengthCounts[length]++;
+		if(length > treeDepth)
+		{
+			treeDepth = length;
+		}
+	}
+	pthread_mutex_unlock(&statsLock);
+}
+
+void printStats(FILE* out)
+{
+	if(!statsEnabled)
+	{
+		return;
+	}
+
+	fprintf(out, "%-10s %10s %10s %8s\n", "stage", "wall ms", "cpu ms", "calls");
+	int i;
+	for(i = 0; i < STATS_STAGE_COUNT; i++)
+	{
+		if(stageCalls[i] > 0)
+		{
+			fprintf(out, "%-10s %10.3f %10.3f %8lu\n", STATS_STAGE_NAMES[i], stageWallSeconds[i] * 1e3, stageCpuSeconds[i] * 1e3,
+				(unsigned long)stageCalls[i]);
+		}
+	}
+
+	// Bits per symbol are compressed bits over original characters, whichever way the data went
+	uint64_t symbols = statsCounters[STATS_SYMBOLS];
+	uint64_t compressedBytes = statsCounters[STATS_COMPRESSED_BYTES];
+	fprintf(out, "bytes in %lu, bytes out %lu, %.3f bits per symbol\n", (unsigned long)statsCounters[STATS_BYTES_IN],
+		(unsigned long)statsCounters[STATS_BYTES_OUT], symbols > 0 ? compressedBytes * 8.0 / symbols : 0);
+
+	// Code lengths of characters that have a code, Pseudo-EOF included
+	if(treeDepth > 0)
+	{
+		fprintf(out, "tree depth %d, code lengths:", treeDepth);
+		for(i = 1; i <= treeDepth; i++)
+		{
+			if(lengthCounts[i] > 0)
+			{
+				fprintf(out, " %d:%lu", i, (unsigned long)lengthCounts[i]);
+			}
+		}
+		fprintf(out, "\n");
+	}
+	fprintf(out, "I/O calls: %lu reads, %lu writes, %lu maps\n", (unsigned long)statsCounters[STATS_READ_CALLS],
+		(unsigned long)statsCounters[STATS_WRITE_CALLS], (unsigned long)statsCounters[STATS_MAP_CALLS]);
+}
@@ -0,0 +1,121 @@
+#ifndef __test_h_
+#define __test_h_
+
+#include "libhuff.h"
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Fills 'data' with words of a small vocabulary, skewed enough for every mode to shrink it
+static inline void fillText(unsigned char* data, size_t size)
+{
+	const char* words[] = {"the ", "huffman ", "code ", "of ", "a ", "tree ", "is ", "prefix ", "free\n"};
+	uint32_t state = 12345;
+	size_t i = 0;
+	while(i < size)
+	{
+		state = state * 1103515245 + 12345;
+		const char* word = words[(state >> 16) % (sizeof(words) / sizeof(*words))];
+		size_t j;
+		for(j = 0; word[j] != '\0' && i < size; j++)
+		{
+			data[i++] = word[j];
+		}
+	}
+}
+
+// Moves into a directory of its own for the test under test_output, next to the output directories
+// huff and unhuff write to, so tests running side by side never share files
+static inline bool enterWorkDirectory(const char* name)
+{
+	mkdir("test_output", 0777);
+	if(chdir("test_output") != 0)
+	{
+		return false;
+	}
+	mkdir(name, 0777);
+	if(chdir(name) != 0)
+	{
+		return false;
+	}
+	mkdir("work", 0777);
+	mkdir("Compressed Output", 0777);
+	mkdir("Uncompressed Output", 0777);
+	return chdir("work") == 0;
+}
+
+static inline bool writeFile(const char* filename, const void* data, size_t size)
+{
+	FILE* fp = fopen(filename, "wb");
+	if(fp == NULL)
+	{
+		return false;
+	}
+	bool success = fwrite(data, 1, size, fp) == size;
+	return (fclose(fp) == 0) && success;
+}
+
+// Returns the whole file in memory from malloc, NULL if it cannot be read
+static inline unsigned char* readFile(const char* filename, size_t* size)
+{
+	FILE* fp = fopen(filename, "rb");
+	if(fp == NULL)
+	{
+		return NULL;
+	}
+	fseek(fp, 0, SEEK_END);
+	*size = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+	unsigned char* data = malloc(*size + 1);
+	if(fread(data, 1, *size, fp) != *size)
+	{
+		free(data);
+		data = NULL;
+	}
+	fclose(fp);
+	return data;
+}
+
+// Runs a shell command built like printf, with its messages hidden, and returns its exit status
+static inline int runCommand(const char* format, ...)
+{
+	char command[4096];
+	va_list arguments;
+	va_start(arguments, format);
+	int length = vsnprintf(command, sizeof(command) - 16, format, arguments);
+	va_end(arguments);
+	snprintf(command + length, 16, " 2>/dev/null");
+	int status = system(command);
+	return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+// Decodes 'compressed' as the file 'name'.huff with unhuff and its options, and with huff_decompress.
+// Returns true if either accepts it, setting whether both gave back the 'size' bytes of 'data'
+static inline bool decodeBoth(const char* unhuff, const char* options, HuffContext* context, const char* name,
+	const unsigned char* compressed, size_t compressedSize, const unsigned char* data, size_t size, bool* matches)
+{
+	char filename[256];
+	snprintf(filename, sizeof(filename), "../Compressed Output/%s.huff", name);
+	writeFile(filename, compressed, compressedSize);
+	snprintf(filename, sizeof(filename), "../Uncompressed Output/%s.huff.unhuff", name);
+	remove(filename);
+	bool unhuffed = runCommand("cd '../Compressed Output' && %s %s %s.huff", unhuff, options, name) == 0;
+	size_t outputSize = 0;
+	unsigned char* output = readFile(filename, &outputSize);
+	*matches = unhuffed && output != NULL && outputSize == size && memcmp(output, data, size) == 0;
+	free(output);
+
+	output = malloc(size + 1);
+	int result = huff_decompress(context, compressed, compressedSize, output, size, &outputSize);
+	*matches = *matches && result == HUFF_OK && outputSize == size && memcmp(output, data, size) == 0;
+	free(output);
+	return unhuffed || result == HUFF_OK;
+}
+
+#endif
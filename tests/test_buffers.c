@@ -0,0 +1,165 @@
+#include "huff.h"
+#include "libhuff.h"
+#include "test.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Number of characters in the text every test compresses
+#define TEST_SIZE 65536
+
+// Compresses and decompresses 'data' with the context's settings, returns a HUFF_ result and
+// whether the output matches
+int roundTrip(HuffContext* context, const unsigned char* data, size_t size, bool* matches)
+{
+	size_t bound = huff_compress_bound(context, size);
+	unsigned char* compressed = malloc(bound);
+	unsigned char* output = malloc(size);
+	size_t compressedSize = 0;
+	size_t outputSize = 0;
+	*matches = false;
+	int result = huff_compress(context, data, size, compressed, bound, &compressedSize);
+	if(result == HUFF_OK)
+	{
+		result = huff_decompress(context, compressed, compressedSize, output, size, &outputSize);
+		*matches = (compressedSize < size && outputSize == size && memcmp(data, output, size) == 0);
+	}
+	free(output);
+	free(compressed);
+	return result;
+}
+
+// Compresses 'data' and decompresses cut down copies of it, returns the number of cuts not reported
+// as damaged input
+int countMissedCuts(HuffContext* context, const unsigned char* data, size_t size)
+{
+	size_t bound = huff_compress_bound(context, size);
+	unsigned char* compressed = malloc(bound);
+	unsigned char* output = malloc(size);
+	size_t compressedSize = 0;
+	size_t outputSize = 0;
+	huff_compress(context, data, size, compressed, bound, &compressedSize);
+
+	// Cuts inside the tag and header, halfway and inside the last codes
+	size_t cuts[] = {0, 1, 2, compressedSize / 2, compressedSize - 2, compressedSize - 1};
+	int missed = 0;
+	size_t i;
+	for(i = 0; i < sizeof(cuts) / sizeof(*cuts); i++)
+	{
+		int result = huff_decompress(context, compressed, cuts[i], output, size, &outputSize);
+		if(result != HUFF_ERROR_INVALID_INPUT)
+		{
+			fprintf(stderr, "FAIL: %zu of %zu bytes give %s\n", cuts[i], compressedSize, huff_error_string(result));
+			missed++;
+		}
+	}
+	free(output);
+	free(compressed);
+	return missed;
+}
+
+// Serializes a model trained on 'data' into memory from the arena, returns its size
+size_t trainOn(Arena* arena, const unsigned char* data, size_t size, unsigned char** model)
+{
+	unsigned long* frequencies = arenaAlloc(arena, ASCII_COUNT * sizeof(*frequencies));
+	memset(frequencies, 0, ASCII_COUNT * sizeof(*frequencies));
+	countBytes(data, size, frequencies);
+	return writeModel(arena, trainModel(arena, frequencies, MAX_CODE_LENGTH), model);
+}
+
+int main()
+{
+	HuffContext* context = huff_create_context();
+	Arena* arena = createArena(ARENA_BLOCK_SIZE);
+	unsigned char* data = malloc(TEST_SIZE);
+	fillText(data, TEST_SIZE);
+	int failures = 0;
+
+	// Every setting huff_compress offers comes back as it went in, and smaller
+	bool matches;
+	int result = roundTrip(context, data, TEST_SIZE, &matches);
+	if(result != HUFF_OK || !matches)
+	{
+		fprintf(stderr, "FAIL: order 0 round trip gives %s\n", huff_error_string(result));
+		failures++;
+	}
+	huff_set_order(context, 1);
+	result = roundTrip(context, data, TEST_SIZE, &matches);
+	if(result != HUFF_OK || !matches)
+	{
+		fprintf(stderr, "FAIL: order 1 round trip gives %s\n", huff_error_string(result));
+		failures++;
+	}
+	huff_set_order(context, 0);
+	unsigned char* model;
+	size_t modelSize = trainOn(arena, data, TEST_SIZE, &model);
+	result = huff_set_model(context, model, modelSize);
+	if(result == HUFF_OK)
+	{
+		result = roundTrip(context, data, TEST_SIZE, &matches);
+	}
+	if(result != HUFF_OK || !matches)
+	{
+		fprintf(stderr, "FAIL: model round trip gives %s\n", huff_error_string(result));
+		failures++;
+	}
+
+	// Model data cannot be read without the model
+	size_t bound = huff_compress_bound(context, TEST_SIZE);
+	unsigned char* compressed = malloc(bound);
+	unsigned char* output = malloc(TEST_SIZE);
+	size_t compressedSize = 0;
+	size_t outputSize = 0;
+	huff_compress(context, data, TEST_SIZE, compressed, bound, &compressedSize);
+	huff_set_model(context, NULL, 0);
+	result = huff_decompress(context, compressed, compressedSize, output, TEST_SIZE, &outputSize);
+	if(result != HUFF_ERROR_WRONG_MODEL)
+	{
+		fprintf(stderr, "FAIL: model data without its model gives %s\n", huff_error_string(result));
+		failures++;
+	}
+
+	// Buffers one byte short of the result are turned down on both sides
+	result = huff_compress(context, data, TEST_SIZE, compressed, bound, &compressedSize);
+	size_t exactSize = compressedSize;
+	result = huff_compress(context, data, TEST_SIZE, compressed, exactSize - 1, &compressedSize);
+	if(result != HUFF_ERROR_OUTPUT_TOO_SMALL)
+	{
+		fprintf(stderr, "FAIL: compressing into a short buffer gives %s\n", huff_error_string(result));
+		failures++;
+	}
+	huff_compress(context, data, TEST_SIZE, compressed, bound, &compressedSize);
+	result = huff_decompress(context, compressed, compressedSize, output, TEST_SIZE - 1, &outputSize);
+	if(result != HUFF_ERROR_OUTPUT_TOO_SMALL)
+	{
+		fprintf(stderr, "FAIL: decompressing into a short buffer gives %s\n", huff_error_string(result));
+		failures++;
+	}
+
+	// Data cut short, or with a damaged header or tag, is reported rather than decoded
+	failures += countMissedCuts(context, data, TEST_SIZE);
+	huff_set_order(context, 1);
+	failures += countMissedCuts(context, data, TEST_SIZE);
+	huff_set_order(context, 0);
+	compressed[1] = 0xFF;
+	result = huff_decompress(context, compressed, compressedSize, output, TEST_SIZE, &outputSize);
+	if(result != HUFF_ERROR_INVALID_INPUT)
+	{
+		fprintf(stderr, "FAIL: a damaged header gives %s\n", huff_error_string(result));
+		failures++;
+	}
+	compressed[0] = 0xBF;
+	result = huff_decompress(context, compressed, compressedSize, output, TEST_SIZE, &outputSize);
+	if(result != HUFF_ERROR_UNKNOWN_FORMAT)
+	{
+		fprintf(stderr, "FAIL: an unknown tag gives %s\n", huff_error_string(result));
+		failures++;
+	}
+
+	free(output);
+	free(compressed);
+	free(data);
+	freeArena(arena);
+	huff_free_context(context);
+	return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
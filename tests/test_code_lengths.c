@@ -0,0 +1,120 @@
+#include "huff.h"
+#include "libhuff.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Number of characters coded in each test, enough for every code to start at every bit offset
+#define TEST_SIZE 4096
+
+// Gives characters 0 to 'longest' - 2 lengths 1 to 'longest' - 1 and two codes of 'longest',
+// one of them Pseudo-EOF, so the lengths form a complete code
+void setLengths(Code* codeTable, int longest)
+{
+	memset(codeTable, 0, sizeof(*codeTable) * ASCII_COUNT);
+	int i;
+	for(i = 0; i < longest - 1; i++)
+	{
+		codeTable[i].length = i + 1;
+	}
+	codeTable[longest - 1].length = longest;
+	codeTable[PSEUDO_EOF_VALUE].length = longest;
+}
+
+// Writes a canonical file with the lengths above, then returns what huff_decompress makes of it
+int roundTrip(HuffContext* context, int longest, bool* matches)
+{
+	Arena* arena = createArena(ARENA_BLOCK_SIZE);
+	Code codeTable[ASCII_COUNT];
+	setLengths(codeTable, longest);
+	assignCanonicalCodes(codeTable);
+	int i;
+
+	// Long codes after short ones of every length, so they are read from every register fill
+	unsigned char* data = malloc(TEST_SIZE);
+	for(i = 0; i < TEST_SIZE; i++)
+	{
+		data[i] = (i % 2 == 0) ? longest - 1 - (i / 2) % 3 : (i * 7) % longest;
+	}
+
+	BitWriter* writer = createMemoryBitWriter(arena, TEST_SIZE * 8 + CODE_LENGTHS_BOUND + 16);
+	writeBits(writer, FORMAT_CANONICAL, 8);
+	writeCodeLengths(writer, codeTable);
+	encodeData(writer, codeTable, data, TEST_SIZE);
+	writeBits(writer, codeTable[PSEUDO_EOF_VALUE].bits, codeTable[PSEUDO_EOF_VALUE].length);
+	flushBitWriter(writer);
+
+	unsigned char* output = malloc(TEST_SIZE);
+	size_t outputSize = 0;
+	int result = huff_decompress(context, writer -> buffer, writer -> position, output, TEST_SIZE, &outputSize);
+	*matches = (outputSize == TEST_SIZE && memcmp(data, output, TEST_SIZE) == 0);
+
+	free(output);
+	free(data);
+	freeArena(arena);
+	return result;
+}
+
+// Writes only the header of a canonical file with the lengths above, which never get codes, and
+// returns what huff_decompress makes of it
+int decodeHeader(HuffContext* context, int longest)
+{
+	Arena* arena = createArena(ARENA_BLOCK_SIZE);
+	Code codeTable[ASCII_COUNT];
+	setLengths(codeTable, longest);
+
+	BitWriter* writer = createMemoryBitWriter(arena, CODE_LENGTHS_BOUND + 16);
+	writeBits(writer, FORMAT_CANONICAL, 8);
+	writeCodeLengths(writer, codeTable);
+	flushBitWriter(writer);
+
+	unsigned char output[1];
+	size_t outputSize = 0;
+	int result = huff_decompress(context, writer -> buffer, writer -> position, output, sizeof(output), &outputSize);
+	freeArena(arena);
+	return result;
+}
+
+int main()
+{
+	HuffContext* context = huff_create_context();
+	int failures = 0;
+
+	// Codes of the longest length the decoder accepts come back as they went in
+	bool matches;
+	int result = roundTrip(context, MAX_CODE_LENGTH, &matches);
+	if(result != HUFF_OK || !matches)
+	{
+		fprintf(stderr, "FAIL: %d-bit codes decode to %s\n", MAX_CODE_LENGTH, huff_error_string(result));
+		failures++;
+	}
+
+	// One bit longer, the header must be turned down rather than misread
+	result = decodeHeader(context, MAX_CODE_LENGTH + 1);
+	if(result != HUFF_ERROR_INVALID_INPUT)
+	{
+		fprintf(stderr, "FAIL: %d-bit codes are not rejected\n", MAX_CODE_LENGTH + 1);
+		failures++;
+	}
+
+	// Limits are checked against the same bound
+	if(huff_set_max_length(context, MAX_CODE_LENGTH) != HUFF_OK || huff_set_max_length(context, MAX_CODE_LENGTH + 1) == HUFF_OK)
+	{
+		fprintf(stderr, "FAIL: huff_set_max_length does not stop at %d bits\n", MAX_CODE_LENGTH);
+		failures++;
+	}
+
+	// Inputs too small for codes to pay for their header are stored, never grown past the tag
+	const unsigned char tiny[] = "aaa\n";
+	unsigned char compressed[64];
+	size_t compressedSize = 0;
+	result = huff_compress(context, tiny, sizeof(tiny) - 1, compressed, sizeof(compressed), &compressedSize);
+	if(result != HUFF_OK || compressedSize > sizeof(tiny))
+	{
+		fprintf(stderr, "FAIL: %zu-byte input compresses to %zu bytes\n", sizeof(tiny) - 1, compressedSize);
+		failures++;
+	}
+
+	huff_free_context(context);
+	return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
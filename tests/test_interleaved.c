@@ -0,0 +1,109 @@
+#include "huff.h"
+#include "test.h"
+
+// Number of characters in the file, two whole chunks and a last one that does not split evenly
+#define TEST_SIZE (2 * INTERLEAVE_CHUNK_SIZE + 40003)
+
+int main(int argc, char** argv)
+{
+	// Run by ctest with the huff and unhuff executables, in the build directory
+	if(argc != 3 || !enterWorkDirectory("interleaved"))
+	{
+		fprintf(stderr, "Usage: test_interleaved huff unhuff\n");
+		return EXIT_FAILURE;
+	}
+	HuffContext* context = huff_create_context();
+	unsigned char* data = malloc(TEST_SIZE);
+	fillText(data, TEST_SIZE);
+	writeFile("interleaved", data, TEST_SIZE);
+
+	size_t compressedSize = 0;
+	unsigned char* compressed = NULL;
+	if(runCommand("%s -i interleaved", argv[1]) == 0)
+	{
+		compressed = readFile("../Compressed Output/interleaved.huff", &compressedSize);
+	}
+	if(compressed == NULL || compressedSize < 64 || compressed[0] != FORMAT_INTERLEAVED)
+	{
+		fprintf(stderr, "FAIL: huff -i does not compress\n");
+		return EXIT_FAILURE;
+	}
+
+	int failures = 0;
+	bool matches;
+	decodeBoth(argv[2], "", context, "interleaved", compressed, compressedSize, data, TEST_SIZE, &matches);
+	if(!matches)
+	{
+		fprintf(stderr, "FAIL: huff -i does not decode to the original\n");
+		failures++;
+	}
+
+	// Cuts inside the code lengths, the first chunk header, the streams, and the header that ends the file
+	size_t cuts[] = {1, 3, 80, compressedSize / 2, compressedSize - INTERLEAVE_HEADER_SIZE - 1,
+		compressedSize - INTERLEAVE_HEADER_SIZE, compressedSize - 1};
+	size_t i;
+	for(i = 0; i < sizeof(cuts) / sizeof(*cuts); i++)
+	{
+		if(decodeBoth(argv[2], "", context, "interleaved", compressed, cuts[i], data, TEST_SIZE, &matches))
+		{
+			fprintf(stderr, "FAIL: huff -i cut to %zu of %zu bytes decodes\n", cuts[i], compressedSize);
+			failures++;
+		}
+	}
+
+	// A last chunk whose streams run past the end of the file, that claims more characters than its
+	// streams hold, or whose first stream is cut short by moving its last bytes to the second
+	BitReader reader;
+	Code codeTable[ASCII_COUNT];
+	initMemoryBitReader(&reader, compressed + 1, compressedSize - 1);
+	readCodeLengths(&reader, codeTable);
+	alignToByte(&reader);
+	size_t lastChunk = 1 + getReaderOffset(&reader);
+	size_t lastSize = TEST_SIZE % INTERLEAVE_CHUNK_SIZE;
+	size_t part = (lastSize + INTERLEAVE_STREAMS - 1) / INTERLEAVE_STREAMS;
+	int chunk;
+	for(chunk = 0; chunk < TEST_SIZE / INTERLEAVE_CHUNK_SIZE; chunk++)
+	{
+		size_t total = INTERLEAVE_HEADER_SIZE;
+		int stream;
+		for(stream = 0; stream < INTERLEAVE_STREAMS; stream++)
+		{
+			total += readUint32(compressed + lastChunk + 4 + 4 * stream);
+		}
+		lastChunk += total;
+	}
+	if(readUint32(compressed + lastChunk) != lastSize)
+	{
+		fprintf(stderr, "FAIL: the last chunk of huff -i does not hold %zu characters\n", lastSize);
+		failures++;
+	}
+	unsigned char* damaged = malloc(compressedSize);
+	memcpy(damaged, compressed, compressedSize);
+	writeUint32(damaged + lastChunk + 4, readUint32(compressed + lastChunk + 4) + INTERLEAVE_HEADER_SIZE + 1);
+	if(decodeBoth(argv[2], "", context, "interleaved", damaged, compressedSize, data, TEST_SIZE, &matches))
+	{
+		fprintf(stderr, "FAIL: huff -i with a stream past the end decodes\n");
+		failures++;
+	}
+	memcpy(damaged, compressed, compressedSize);
+	writeUint32(damaged + lastChunk, lastSize + INTERLEAVE_STREAMS * part);
+	if(decodeBoth(argv[2], "", context, "interleaved", damaged, compressedSize, data, TEST_SIZE, &matches))
+	{
+		fprintf(stderr, "FAIL: huff -i with a chunk longer than its streams decodes\n");
+		failures++;
+	}
+	memcpy(damaged, compressed, compressedSize);
+	writeUint32(damaged + lastChunk + 4, readUint32(compressed + lastChunk + 4) - 4);
+	writeUint32(damaged + lastChunk + 8, readUint32(compressed + lastChunk + 8) + 4);
+	if(decodeBoth(argv[2], "", context, "interleaved", damaged, compressedSize, data, TEST_SIZE, &matches))
+	{
+		fprintf(stderr, "FAIL: huff -i with a stream cut short decodes\n");
+		failures++;
+	}
+
+	free(damaged);
+	free(compressed);
+	free(data);
+	huff_free_context(context);
+	return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,92 @@
+#include "libhuff.h"
+#include "test.h"
+#include <string.h>
+
+// Number of characters in the file read back, over a dozen blocks of BLOCK_KIB
+#define TEST_SIZE 200000
+#define BLOCK_KIB 16
+
+// Reads a range and checks it against the original, returns true if both the result and bytes are right
+bool checkRange(HuffRange* range, const unsigned char* data, uint64_t offset, size_t length, const char* name)
+{
+	unsigned char* output = malloc(length + 1);
+	size_t outputSize = 0;
+	int result = huff_read_range(range, offset, length, output, &outputSize);
+
+	// Ranges past the end are cut at it, those starting there are empty
+	size_t expected = offset >= TEST_SIZE ? 0 : (length < TEST_SIZE - offset ? length : TEST_SIZE - offset);
+	bool matches = result == HUFF_OK && outputSize == expected && memcmp(output, data + (offset < TEST_SIZE ? offset : 0), expected) == 0;
+	if(!matches)
+	{
+		fprintf(stderr, "FAIL: %s range %llu:%zu gives %s and %zu bytes\n", name, (unsigned long long)offset, length,
+			huff_error_string(result), outputSize);
+	}
+	free(output);
+	return matches;
+}
+
+// Compresses the data with the given huff options and reads ranges of it, returns the number of failures
+int checkRanges(const char* huff, const char* options, const unsigned char* data)
+{
+	if(runCommand("%s %s ranges.txt", huff, options) != 0)
+	{
+		fprintf(stderr, "FAIL: huff %s does not compress\n", options);
+		return 1;
+	}
+	HuffRange* range = huff_open_range("../Compressed Output/ranges.txt.huff");
+	if(range == NULL)
+	{
+		fprintf(stderr, "FAIL: huff %s output has no block index\n", options);
+		return 1;
+	}
+
+	int failures = 0;
+	size_t block = BLOCK_KIB * 1024;
+	failures += !checkRange(range, data, block - 100, 2 * block + 200, options);
+	failures += !checkRange(range, data, 0, 1, options);
+	failures += !checkRange(range, data, TEST_SIZE - 1, 1, options);
+	failures += !checkRange(range, data, TEST_SIZE - 10, 100, options);
+	failures += !checkRange(range, data, block, 0, options);
+	failures += !checkRange(range, data, TEST_SIZE, 10, options);
+	failures += !checkRange(range, data, (uint64_t)TEST_SIZE * 4, 10, options);
+
+	// The block cached by one read must not leak into the next
+	failures += !checkRange(range, data, 3 * block + 7, 5, options);
+	failures += !checkRange(range, data, 7, 5, options);
+	huff_close_range(range);
+	return failures;
+}
+
+int main(int argc, char** argv)
+{
+	// Run by ctest with the huff executable, in the build directory
+	if(argc != 2 || !enterWorkDirectory("ranges"))
+	{
+		fprintf(stderr, "Usage: test_ranges huff\n");
+		return EXIT_FAILURE;
+	}
+	unsigned char* data = malloc(TEST_SIZE);
+	fillText(data, TEST_SIZE);
+	writeFile("ranges.txt", data, TEST_SIZE);
+	int failures = 0;
+
+	// Both files with an index, blocks with their own codes and segments of one set of codes
+	char options[64];
+	snprintf(options, sizeof(options), "-b %d", BLOCK_KIB);
+	failures += checkRanges(argv[1], options, data);
+	snprintf(options, sizeof(options), "-s %d", BLOCK_KIB);
+	failures += checkRanges(argv[1], options, data);
+
+	// Files without an index are turned down
+	runCommand("%s -c ranges.txt", argv[1]);
+	HuffRange* range = huff_open_range("../Compressed Output/ranges.txt.huff");
+	if(range != NULL)
+	{
+		fprintf(stderr, "FAIL: a canonical file opens for ranges\n");
+		huff_close_range(range);
+		failures++;
+	}
+
+	free(data);
+	return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
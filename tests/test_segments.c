@@ -0,0 +1,90 @@
+#include "huff.h"
+#include "test.h"
+
+// Number of characters in the file, over a dozen segments of SEGMENT_KIB
+#define TEST_SIZE 200000
+#define SEGMENT_KIB 16
+
+// Compresses the data with the given huff option, then decodes it whole, cut short and with a damaged
+// index. Returns the number of failures
+int checkSegments(const char* huff, const char* unhuff, HuffContext* context, const char* option, const unsigned char* data)
+{
+	size_t compressedSize = 0;
+	unsigned char* compressed = NULL;
+	if(runCommand("%s %s %d segments", huff, option, SEGMENT_KIB) == 0)
+	{
+		compressed = readFile("../Compressed Output/segments.huff", &compressedSize);
+	}
+	if(compressed == NULL || compressedSize < 64)
+	{
+		fprintf(stderr, "FAIL: huff %s does not compress\n", option);
+		free(compressed);
+		return 1;
+	}
+
+	int failures = 0;
+	bool matches;
+	decodeBoth(unhuff, "-t 4", context, "segments", compressed, compressedSize, data, TEST_SIZE, &matches);
+	if(!matches)
+	{
+		fprintf(stderr, "FAIL: huff %s does not decode to the original\n", option);
+		failures++;
+	}
+
+	// Cuts inside the header, the segments, the index and the footer
+	size_t cuts[] = {1, 3, compressedSize / 2, compressedSize - BLOCK_FOOTER_SIZE - BLOCK_INDEX_ENTRY_SIZE / 2,
+		compressedSize - BLOCK_FOOTER_SIZE, compressedSize - 1};
+	size_t i;
+	for(i = 0; i < sizeof(cuts) / sizeof(*cuts); i++)
+	{
+		if(decodeBoth(unhuff, "-t 4", context, "segments", compressed, cuts[i], data, TEST_SIZE, &matches))
+		{
+			fprintf(stderr, "FAIL: huff %s cut to %zu of %zu bytes decodes\n", option, cuts[i], compressedSize);
+			failures++;
+		}
+	}
+
+	// An index that points segments past the end of the file, or counts more segments than it holds
+	unsigned char* damaged = malloc(compressedSize);
+	size_t firstEntry = compressedSize - BLOCK_FOOTER_SIZE - (size_t)readUint32(compressed + compressedSize - 4) * BLOCK_INDEX_ENTRY_SIZE;
+	memcpy(damaged, compressed, compressedSize);
+	writeUint32(damaged + firstEntry, readUint32(compressed + firstEntry) + compressedSize);
+	if(decodeBoth(unhuff, "-t 4", context, "segments", damaged, compressedSize, data, TEST_SIZE, &matches))
+	{
+		fprintf(stderr, "FAIL: huff %s with a segment past the end decodes\n", option);
+		failures++;
+	}
+	memcpy(damaged, compressed, compressedSize);
+	writeUint32(damaged + compressedSize - 4, readUint32(compressed + compressedSize - 4) + 1);
+	if(decodeBoth(unhuff, "-t 4", context, "segments", damaged, compressedSize, data, TEST_SIZE, &matches))
+	{
+		fprintf(stderr, "FAIL: huff %s with one segment too many decodes\n", option);
+		failures++;
+	}
+
+	free(damaged);
+	free(compressed);
+	return failures;
+}
+
+int main(int argc, char** argv)
+{
+	// Run by ctest with the huff and unhuff executables, in the build directory
+	if(argc != 3 || !enterWorkDirectory("segments"))
+	{
+		fprintf(stderr, "Usage: test_segments huff unhuff\n");
+		return EXIT_FAILURE;
+	}
+	HuffContext* context = huff_create_context();
+	unsigned char* data = malloc(TEST_SIZE);
+	fillText(data, TEST_SIZE);
+	writeFile("segments", data, TEST_SIZE);
+
+	// Sync points in one set of codes, and blocks with codes of their own
+	int failures = checkSegments(argv[1], argv[2], context, "-s", data);
+	failures += checkSegments(argv[1], argv[2], context, "-b", data);
+
+	free(data);
+	huff_free_context(context);
+	return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
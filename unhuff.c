@@ -1,230 +1,742 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <ctype.h>
 #include <unistd.h>
 #include <stdbool.h>
-#include <unistd.h>
+#include <sys/stat.h>
 
 #include "huff.h"
 
 int main(int argc, char* argv[])
 {
-	if(argc == 1)
+	// Read options, every other argument is a file to decompress
+	DecompressOptions options;
+	options.memoryUsage = false;
+	options.threadCount = getProcessorCount();
+	options.model = NULL;
+	options.direct = false;
+	int jobCount = getProcessorCount();
+	bool rangeMode = false;
+	uint64_t rangeOffset = 0;
+	uint64_t rangeLength = 0;
+	char* modelFilename = NULL;
+	char* listFilename = NULL;
+	char** files = malloc(sizeof(*files) * argc);
+	int fileCount = 0;
+	int i;
+	for(i = 1; i < argc; i++)
 	{
-		printf("Must pass in a filename to decompress.\n");
+		if(strcmp(argv[i], "-m") == 0 || strcmp(argv[i], "--memory") == 0)
+		{
+			options.memoryUsage = true;
+		}
+		else if((strcmp(argv[i], "-t") == 0 || strcmp(argv[i], "--threads") == 0) && i + 1 < argc)
+		{
+			options.threadCount = atoi(argv[++i]);
+			if(options.threadCount < 1)
+			{
+				fprintf(stderr, "Thread count must be at least 1.\n");
+				return EXIT_FAILURE;
+			}
+		}
+		else if((strcmp(argv[i], "-j") == 0 || strcmp(argv[i], "--jobs") == 0) && i + 1 < argc)
+		{
+			jobCount = atoi(argv[++i]);
+			if(jobCount < 1)
+			{
+				fprintf(stderr, "Job count must be at least 1.\n");
+				return EXIT_FAILURE;
+			}
+		}
+		else if((strcmp(argv[i], "-r") == 0 || strcmp(argv[i], "--range") == 0) && i + 1 < argc)
+		{
+			// Range is given as offset:length in bytes of the original file, both halves only digits
+			char* offset = argv[++i];
+			char* end;
+			rangeMode = true;
+			rangeOffset = strtoull(offset, &end, 10);
+			char* length = end + 1;
+			if(!isdigit((unsigned char)*offset) || *end != ':' || !isdigit((unsigned char)*length))
+			{
+				fprintf(stderr, "Range must be given as offset:length.\n");
+				return EXIT_FAILURE;
+			}
+			rangeLength = strtoull(length, &end, 10);
+			if(*end != '\0')
+			{
+				fprintf(stderr, "Range must be given as offset:length.\n");
+				return EXIT_FAILURE;
+			}
+		}
+		else if((strcmp(argv[i], "-M") == 0 || strcmp(argv[i], "--model") == 0) && i + 1 < argc)
+		{
+			modelFilename = argv[++i];
+		}
+		else if((strcmp(argv[i], "-L") == 0 || strcmp(argv[i], "--list") == 0) && i + 1 < argc)
+		{
+			listFilename = argv[++i];
+		}
+		else if(strcmp(argv[i], "--direct") == 0)
+		{
+			options.direct = true;
+		}
+		else if(strcmp(argv[i], "--stats") == 0)
+		{
+			enableStats();
+		}
+		else
+		{
+			files[fileCount++] = argv[i];
+		}
+	}
+	if(fileCount == 0 && (listFilename == NULL || rangeMode))
+	{
+		fprintf(stderr, "Must pass in a filename to decompress.\n");
+		free(files);
 		return EXIT_FAILURE;
 	}
+	Arena* arena = createArena(ARENA_BLOCK_SIZE);
+	bool success = true;
 
-	// Preparation
-	char* filename = argv[1];
-	FILE* fp = fopen(filename, "rb");
-	unsigned char byte = 0;
-	int level = 0;
+	// The model is read once and shared by every file
+	if(modelFilename != NULL)
+	{
+		options.model = loadModel(arena, modelFilename);
+		success = (options.model != NULL);
+	}
 
-	Node* huffmanTree = reconstructTree(fp, &byte, &level);
-	writeDecompressed(fp, huffmanTree, filename, &byte, &level);
+	// Ranges are read through the block index, decoding only the blocks that hold them
+	if(success && rangeMode)
+	{
+		OutputFile* decompressed = openDecompressed(arena, files[0], options.direct);
+		success = decompressed != NULL && writeRange(files[0], rangeOffset, rangeLength, decompressed);
+		if(decompressed != NULL)
+		{
+			success = closeOutput(decompressed) && success;
+		}
+	}
+	else if(success)
+	{
+		// Several files, directories or a list are decompressed concurrently, each worker reusing its memory
+		int batchCount = 0;
+		char** batch = collectFiles(arena, files, fileCount, listFilename, "../Uncompressed Output/", &batchCount);
+		if(batch == NULL)
+		{
+			success = false;
+		}
+		else if(batchCount == 1 && fileCount == 1 && listFilename == NULL && batch[0] == files[0])
+		{
+			success = decompressFile(arena, files[0], &options);
+		}
+		else
+		{
+			success = runBatch(batch, batchCount, jobCount, decompressFile, &options);
+		}
+	}
 
-	fclose(fp);
-	freeTreeHelper(huffmanTree);
-	return EXIT_SUCCESS;
+	printStats(stderr);
+	free(files);
+	freeArena(arena);
+	return success ? EXIT_SUCCESS : EXIT_FAILURE;
 }
 
-void writeDecompressed(FILE* fp, Node* tree, char* filename, unsigned char* byte, int* level)
+bool decompressFile(Arena* arena, char* filename, void* options)
 {
+	DecompressOptions* settings = options;
+	STATS_START(timer);
+
+	// A filename of - decompresses standard input to standard output
+	bool streaming = (strcmp(filename, "-") == 0);
+	FILE* fp = streaming ? stdin : fopen(filename, "rb");
+	if(fp == NULL)
+	{
+		fprintf(stderr, "Cannot open %s\n", filename);
+		return false;
+	}
+	BitReader* reader = createBitReader(arena, fp);
+
 	// Create and open filename.txt.huff.unhuff
-	char* decompressedFilename = malloc(sizeof("../Uncompressed Output/") + strlen(filename) + sizeof(".unhuff"));
-	strcpy(decompressedFilename, "../Uncompressed Output/");
-	strcat(decompressedFilename, filename);
-	strcat(decompressedFilename, ".unhuff");
-	FILE* decompressed = fopen(decompressedFilename, "w");
+	OutputFile* decompressed = streaming ? createOutput(arena, STDOUT_FILENO, "standard output") :
+		openDecompressed(arena, filename, settings -> direct);
+	if(decompressed == NULL)
+	{
+		fclose(fp);
+		return false;
+	}
+	STATS_STAGE(timer, STATS_INPUT);
 
-	// Decompress
-	Node* head = tree;
-	bool PseudoEOF = false;
-	while(!PseudoEOF)
+	// Blocks carry their own headers and start right after the tag, other formats have one header for the whole file.
+	// Those are read in order, by a thread that keeps reading while they are decoded
+	int format = readFormat(reader);
+	if(format != FORMAT_BLOCKS && format != FORMAT_SYNC)
 	{
-		while((tree -> leftChild != NULL) && (tree -> rightChild != NULL))
+		startPrefetch(reader);
+	}
+	bool success = true;
+	if(format == FORMAT_BLOCKS)
+	{
+		success = decompressSegments(fp, NULL, 1, decompressed, filename, settings -> threadCount);
+	}
+	else if(format == FORMAT_STREAM)
+	{
+		success = decompressStream(reader, decompressed, filename);
+	}
+	else if(format == FORMAT_ADAPTIVE)
+	{
+		success = decompressAdaptive(reader, decompressed, filename);
+	}
+	else if(format == FORMAT_STORED)
+	{
+		success = writeStored(reader, decompressed);
+	}
+	else if(format == FORMAT_RUNS)
+	{
+		success = writeRuns(reader, decompressed, filename);
+	}
+	else if(format == FORMAT_INTERLEAVED)
+	{
+		success = decompressInterleaved(arena, reader, decompressed, filename);
+	}
+	else if(format == FORMAT_CONTEXT)
+	{
+		success = decompressContexts(arena, reader, decompressed, filename);
+	}
+	else if(format == FORMAT_MODEL)
+	{
+		// Codes come from the model file, the header only says which model
+		uint32_t id = readBits(reader, 32);
+		if(settings -> model == NULL)
 		{
-			int bit = readBit(fp, byte, level);
-			if(bit == 1)
+			fprintf(stderr, "ERROR: %s needs a model, pass it with --model.\n", filename);
+			success = false;
+		}
+		else if(id != settings -> model -> id)
+		{
+			fprintf(stderr, "ERROR: %s was compressed with another model.\n", filename);
+			success = false;
+		}
+		else
+		{
+			STATS_STAGE(timer, STATS_HEADER);
+			STATS_CODE_LENGTHS(settings -> model -> codes);
+			unsigned long length = 0;
+			success = writeDecompressed(reader, settings -> model -> table, decompressed, filename, &length);
+		}
+	}
+	else if(format == FORMAT_CANONICAL || format == FORMAT_TREE || format == FORMAT_SYNC)
+	{
+		// Rebuild the codes from the header, canonical headers need no tree
+		Code codeTable[ASCII_COUNT];
+		if(format == FORMAT_CANONICAL || format == FORMAT_SYNC)
+		{
+			success = readCodeLengths(reader, codeTable);
+			if(success)
 			{
-				tree = tree -> rightChild;
+				assignCanonicalCodes(codeTable);
 			}
-			else
+		}
+		else
+		{
+			Tree* huffmanTree = reconstructTree(arena, reader);
+			success = (huffmanTree != NULL);
+			if(success)
 			{
-				tree = tree -> leftChild;
+				getBitEncodings(huffmanTree, codeTable);
 			}
 		}
-		if(tree -> value == PSEUDO_EOF_VALUE)
+
+		// Turn the codes into lookup tables and decompress, segments after sync points are
+		// decoded concurrently from the padded end of the header
+		if(success)
 		{
-			PseudoEOF = true;
+			STATS_STAGE(timer, STATS_HEADER);
+			STATS_CODE_LENGTHS(codeTable);
+			DecodeTable* decodeTable = buildDecodeTable(arena, codeTable);
+			STATS_STAGE(timer, STATS_TABLE);
+			unsigned long length = 0;
+			if(format == FORMAT_SYNC)
+			{
+				alignToByte(reader);
+				success = decompressSegments(fp, decodeTable, getReaderOffset(reader), decompressed, filename, settings -> threadCount);
+			}
+			else
+			{
+				success = writeDecompressed(reader, decodeTable, decompressed, filename, &length);
+			}
 		}
 		else
 		{
-			fputc(tree -> value, decompressed);
+			fprintf(stderr, "ERROR: %s has an invalid header.\n", filename);
 		}
-		tree = head;
-	}	
-	fclose(decompressed);
-	free(decompressedFilename);
+	}
+	else
+	{
+		fprintf(stderr, "ERROR: %s has an unknown format.\n", filename);
+		success = false;
+	}
+	success = stopPrefetch(reader) && success;
+	success = flushOutput(decompressed) && success;
+	STATS_STAGE(timer, STATS_DECODE);
+
+	// Sizes are known for files, not for pipes
+	struct stat status;
+	if(!streaming && fstat(fileno(fp), &status) == 0)
+	{
+		STATS_ADD(STATS_BYTES_IN, status.st_size);
+		STATS_ADD(STATS_COMPRESSED_BYTES, status.st_size);
+	}
+	if(!streaming && fstat(decompressed -> fd, &status) == 0)
+	{
+		STATS_ADD(STATS_BYTES_OUT, status.st_size);
+		STATS_ADD(STATS_SYMBOLS, status.st_size);
+	}
+
+	if(settings -> memoryUsage && !streaming)
+	{
+		printArenaUsage(arena, filename);
+	}
+	success = closeOutput(decompressed) && success;
+	fclose(fp);
+	return success;
+}
+
+OutputFile* openDecompressed(Arena* arena, char* filename, bool direct)
+{
+	// Create filename.txt.huff.unhuff
+	char* decompressedFilename = getOutputPath(arena, "../Uncompressed Output/", filename, ".unhuff");
+	return openOutput(arena, decompressedFilename, direct);
 }
 
-Node* reconstructTree(FILE* fp, unsigned char* byte, int* level)
+bool writeDecompressed(BitReader* reader, DecodeTable* table, OutputFile* decompressed, char* filename, unsigned long* length)
 {
-	if(readBit(fp, byte, level) == 1)
+	*length = 0;
+
+	// Decode straight into the output's buffer, handing it over whenever it fills
+	int result = DECODE_FULL;
+	while(result == DECODE_FULL)
 	{
-		if(readBit(fp, byte, level) == 0)
+		size_t position = decompressed -> position;
+		result = decodeSymbols(reader, table, decompressed -> buffer, decompressed -> capacity, &position);
+		*length += position - decompressed -> position;
+		decompressed -> position = position;
+		if(result == DECODE_FULL)
 		{
-			int character = readByte(fp, byte, level);
-			Node* node = createNode(character, 0);
-			return node;
-		}
-		else
-		{
-			readByte(fp, byte, level);
-			int character = PSEUDO_EOF_VALUE;
-			Node* node = createNode(character, 0);
-			return node;
+			submitOutput(decompressed);
 		}
 	}
-	else
+
+	if(result == DECODE_TRUNCATED)
+	{
+		fprintf(stderr, "ERROR: %s ends before Pseudo-EOF character.\n", filename);
+	}
+	else if(result == DECODE_INVALID)
 	{
-		Node* leftChild = reconstructTree(fp, byte, level);
-		Node* rightChild = reconstructTree(fp, byte, level);
-		Node* newNode = createNode('X', 0);
-		newNode -> leftChild = leftChild;
-		newNode -> rightChild = rightChild;
-		return newNode;
+		fprintf(stderr, "ERROR: %s contains an invalid code.\n", filename);
 	}
+	return result == DECODE_END;
 }
 
-void skipByte(FILE* fp, unsigned char* byte, int* level)
+bool writeStored(BitReader* reader, OutputFile* decompressed)
 {
-	int i;
-	for(i = 7; i >= 0; i--)
+	// Fill the output's buffer, straight from the file once the reader's buffer is used up
+	size_t copied;
+	while((copied = readBytes(reader, decompressed -> buffer + decompressed -> position, decompressed -> capacity - decompressed -> position)) > 0)
 	{
-		readBit(fp, byte, level);
+		decompressed -> position += copied;
+		if(decompressed -> position == decompressed -> capacity)
+		{
+			submitOutput(decompressed);
+		}
 	}
+	return true;
 }
 
-int readBit(FILE* fp, unsigned char* byte, int* level)
+bool writeRuns(BitReader* reader, OutputFile* decompressed, char* filename)
 {
-	if(*level == 0)
+	// Original size first, no run may go past it
+	unsigned char header[RUNS_HEADER_SIZE];
+	if(readBytes(reader, header, RUNS_HEADER_SIZE) != RUNS_HEADER_SIZE)
 	{
-		*byte = fgetc(fp);
-		*level = 8;
+		fprintf(stderr, "ERROR: %s has an invalid header.\n", filename);
+		return false;
 	}
-	int bit = ((*byte >> --(*level)) & 1);
-	return bit;
-}
+	uint64_t remaining = readUint64(header);
 
-int readByte(FILE* fp, unsigned char* byte, int* level)
-{
-	int i;
-	int readByte = 0;
-	for(i = 7; i >= 0; i--)
+	// Expand runs into the output's buffer, handing it over whenever it fills
+	unsigned char run[RUN_SIZE];
+	size_t copied;
+	while((copied = readBytes(reader, run, RUN_SIZE)) == RUN_SIZE)
 	{
-		int bit = readBit(fp, byte, level);
-		readByte |= bit << (i);
+		uint32_t length = readUint32(run + 1);
+		if(length > remaining)
+		{
+			fprintf(stderr, "ERROR: %s has a run past its original size.\n", filename);
+			return false;
+		}
+		remaining -= length;
+		while(length > 0)
+		{
+			size_t room = decompressed -> capacity - decompressed -> position;
+			size_t chunk = room < length ? room : length;
+			memset(decompressed -> buffer + decompressed -> position, run[0], chunk);
+			decompressed -> position += chunk;
+			length -= chunk;
+			if(decompressed -> position == decompressed -> capacity)
+			{
+				submitOutput(decompressed);
+			}
+		}
+	}
+	if(copied != 0)
+	{
+		fprintf(stderr, "ERROR: %s ends in the middle of a run.\n", filename);
+		return false;
 	}
-	return readByte;
+	if(remaining != 0)
+	{
+		fprintf(stderr, "ERROR: %s ends before its original size.\n", filename);
+		return false;
+	}
+	return true;
 }
 
-Node* createNode(int value, unsigned long frequency)
+bool decompressInterleaved(Arena* arena, BitReader* reader, OutputFile* decompressed, char* filename)
 {
-	Node* node = malloc(sizeof(*node));
-	node -> value = value;
-	node -> frequency = frequency;
-	node -> left = NULL;
-	node -> right = NULL;
-	node -> leftChild = NULL;
-	node -> rightChild = NULL;
-	node -> code = NULL;
-	return node;
+	Code codeTable[ASCII_COUNT];
+	if(!readCodeLengths(reader, codeTable))
+	{
+		fprintf(stderr, "ERROR: %s has an invalid header.\n", filename);
+		return false;
+	}
+	assignCanonicalCodes(codeTable);
+	STATS_CODE_LENGTHS(codeTable);
+	DecodeTable* table = createDecodeTable(arena, codeTable);
+	alignToByte(reader);
+
+	// Streams of a chunk together can take no more than a whole chunk at the longest code length
+	size_t inputCapacity = getCompressedBound(INTERLEAVE_CHUNK_SIZE, MAX_CODE_LENGTH);
+	unsigned char* input = arenaAlloc(arena, inputCapacity);
+	unsigned char* output = arenaAlloc(arena, INTERLEAVE_CHUNK_SIZE);
+	uint32_t chunk;
+	for(chunk = 0; ; chunk++)
+	{
+		unsigned char header[INTERLEAVE_HEADER_SIZE];
+		if(readBytes(reader, header, INTERLEAVE_HEADER_SIZE) != INTERLEAVE_HEADER_SIZE)
+		{
+			fprintf(stderr, "ERROR: %s ends in the middle of a chunk.\n", filename);
+			return false;
+		}
+		uint32_t size = readUint32(header);
+		if(size == 0)
+		{
+			return true;
+		}
+		uint32_t streamSizes[INTERLEAVE_STREAMS];
+		size_t total = 0;
+		int stream;
+		for(stream = 0; stream < INTERLEAVE_STREAMS; stream++)
+		{
+			streamSizes[stream] = readUint32(header + 4 + 4 * stream);
+			total += streamSizes[stream];
+		}
+		if(size > INTERLEAVE_CHUNK_SIZE || total > inputCapacity)
+		{
+			fprintf(stderr, "ERROR: Chunk %u of %s has an invalid header.\n", chunk, filename);
+			return false;
+		}
+		if(readBytes(reader, input, total) != total)
+		{
+			fprintf(stderr, "ERROR: %s ends in the middle of a chunk.\n", filename);
+			return false;
+		}
+		if(!decodeInterleaved(table, input, streamSizes, output, size))
+		{
+			fprintf(stderr, "ERROR: Chunk %u of %s contains an invalid code.\n", chunk, filename);
+			return false;
+		}
+		writeOutput(decompressed, output, size);
+	}
 }
 
-void printByte(int byte)
+bool decompressContexts(Arena* arena, BitReader* reader, OutputFile* decompressed, char* filename)
 {
-	int i;
-	for(i = 7; i >= 0; i--)
+	ContextModel* model = readContextModel(arena, reader);
+	if(model == NULL)
+	{
+		fprintf(stderr, "ERROR: %s has an invalid header.\n", filename);
+		return false;
+	}
+	int table;
+	for(table = 0; table < model -> tableCount; table++)
+	{
+		STATS_CODE_LENGTHS(model -> codes[table]);
+	}
+
+	// Decode straight into the output's buffer, the model carries the last character over to the next one
+	int result = DECODE_FULL;
+	while(result == DECODE_FULL)
+	{
+		result = decodeContexts(model, reader, decompressed -> buffer, decompressed -> capacity, &decompressed -> position);
+		if(result == DECODE_FULL)
+		{
+			submitOutput(decompressed);
+		}
+	}
+
+	if(result == DECODE_TRUNCATED)
+	{
+		fprintf(stderr, "ERROR: %s ends before Pseudo-EOF character.\n", filename);
+	}
+	else if(result == DECODE_INVALID)
 	{
-		printf("%c", (byte & (1 << i)) ? '1' : '0');
+		fprintf(stderr, "ERROR: %s contains an invalid code.\n", filename);
 	}
-	printf("\n");
+	return result == DECODE_END;
 }
 
-void printNode(Node* node)
+bool decompressAdaptive(BitReader* reader, OutputFile* decompressed, char* filename)
 {
-	// If node has a code
-	if(node -> code != NULL)
+	// Same limit as the encoder gives the same codes at every rebuild
+	unsigned char sizes[BLOCK_INDEX_ENTRY_SIZE];
+	if(readBytes(reader, sizes, 1) != 1 || sizes[0] < MIN_CODE_LENGTH_LIMIT || sizes[0] > MAX_CODE_LENGTH)
 	{
-		if(node -> value == '\n')
+		fprintf(stderr, "ERROR: %s has an invalid header.\n", filename);
+		return false;
+	}
+	AdaptiveModel* model = createAdaptiveModel(sizes[0]);
+	model -> table = createDecodeTable(model -> arena, model -> codes);
+
+	// Every message is read whole, decoded and written before the next is read
+	Arena* messageArena = createArena(ARENA_BLOCK_SIZE);
+	bool success = true;
+	uint32_t message;
+	for(message = 0; success; message++)
+	{
+		// Sizes before each message, both zero after the last one
+		if(readBytes(reader, sizes, BLOCK_INDEX_ENTRY_SIZE) != BLOCK_INDEX_ENTRY_SIZE)
 		{
-			printf("Node: (\\n, %ld, %s)\n", node -> frequency, (char*)node -> code);
+			fprintf(stderr, "ERROR: %s ends before the last message.\n", filename);
+			success = false;
+			break;
 		}
-		else if(node -> value == ' ')
+		uint32_t compressedSize = readUint32(sizes);
+		uint32_t originalSize = readUint32(sizes + 4);
+		if(compressedSize == 0 && originalSize == 0)
 		{
-			printf("Node: ( , %ld, %s)\n", node -> frequency, (char*)node -> code);
+			break;
 		}
-		else if(node -> value == PSEUDO_EOF_VALUE)
+		if(originalSize > MAX_BLOCK_SIZE || compressedSize > getCompressedBound(originalSize, model -> lengthLimit))
 		{
-			printf("Node: (EOF, %ld, EOFCODE)\n", node -> frequency);
+			fprintf(stderr, "ERROR: Message %u of %s has invalid sizes.\n", message, filename);
+			success = false;
+			break;
 		}
-		else
+
+		resetArena(messageArena);
+		unsigned char* input = arenaAlloc(messageArena, compressedSize);
+		unsigned char* output = arenaAlloc(messageArena, originalSize);
+		if(readBytes(reader, input, compressedSize) != compressedSize)
+		{
+			fprintf(stderr, "ERROR: %s ends before the last message.\n", filename);
+			success = false;
+			break;
+		}
+		BitReader* messageReader = createMemoryBitReader(messageArena, input, compressedSize);
+		success = decodeAdaptive(model, messageReader, output, originalSize);
+		if(!success)
 		{
-			printf("Node: (%d, %ld, %s)\n", node -> value, node -> frequency, (char*)node -> code);
+			fprintf(stderr, "ERROR: Message %u of %s contains an invalid code.\n", message, filename);
+			break;
+		}
+		writeOutput(decompressed, output, originalSize);
+		if(!flushOutput(decompressed))
+		{
+			success = false;
 		}
 	}
-	// If node does not have a code
-	else
+
+	freeArena(messageArena);
+	freeAdaptiveModel(model);
+	return success;
+}
+
+bool decompressStream(BitReader* reader, OutputFile* decompressed, char* filename)
+{
+	// Every block is read, decoded and written before the next, in memory reused for each block
+	Arena* blockArena = createArena(ARENA_BLOCK_SIZE);
+	bool success = true;
+	uint32_t block;
+	for(block = 0; success; block++)
 	{
-		if(node -> value == '\n')
+		// Blocks decoded so far go out before waiting for the next one to arrive
+		if(!flushOutput(decompressed))
 		{
-			printf("Node: (\\n, %ld)\n", node -> frequency);
+			success = false;
+			break;
 		}
-		else if(node -> value == ' ')
+
+		// Sizes before each block, both zero after the last one. Zero bytes supplied
+		// past the end of the input must not have been consumed yet
+		uint32_t compressedSize = readBits(reader, 32);
+		uint32_t originalSize = readBits(reader, 32);
+		if(reader -> count < reader -> overrun * 8)
 		{
-			printf("Node: ( , %ld)\n", node -> frequency);
+			fprintf(stderr, "ERROR: %s ends before the last block.\n", filename);
+			success = false;
+			break;
 		}
-		else if(node -> value == PSEUDO_EOF_VALUE)
+		if(compressedSize == 0 && originalSize == 0)
 		{
-			printf("Node: (EOF, %ld)\n",node -> frequency);
+			break;
 		}
-		else
+
+		// Stored and runs blocks are expanded in memory and written whole
+		resetArena(blockArena);
+		if(isRawBlock(reader))
 		{
-			printf("Node: (%d, %ld)\n", node -> value, node -> frequency);
+			unsigned char* output = arenaAlloc(blockArena, originalSize);
+			if(!decodeRawBlock(reader, output, originalSize))
+			{
+				fprintf(stderr, "ERROR: Block %u of %s has the wrong size.\n", block, filename);
+				success = false;
+				break;
+			}
+			writeOutput(decompressed, output, originalSize);
+			continue;
 		}
-
+		Code codeTable[ASCII_COUNT];
+		if(!readCodeLengths(reader, codeTable))
+		{
+			fprintf(stderr, "ERROR: Block %u of %s has an invalid header.\n", block, filename);
+			success = false;
+			break;
+		}
+		assignCanonicalCodes(codeTable);
+		DecodeTable* decodeTable = buildDecodeTable(blockArena, codeTable);
+		unsigned long length = 0;
+		success = writeDecompressed(reader, decodeTable, decompressed, filename, &length);
+		if(success && length != originalSize)
+		{
+			fprintf(stderr, "ERROR: Block %u of %s has the wrong size.\n", block, filename);
+			success = false;
+		}
+		alignToByte(reader);
 	}
+
+	freeArena(blockArena);
+	return success;
 }
 
-void printTree(Node* node, int space)
+bool decompressSegments(FILE* fp, DecodeTable* table, uint64_t firstOffset, OutputFile* decompressed, char* filename, int threadCount)
 {
-	if(node == NULL)
+	// Segments are found through the index at the end of the file and written in place, which pipes cannot do
+	if(lseek(fileno(fp), 0, SEEK_CUR) == -1 || lseek(decompressed -> fd, 0, SEEK_CUR) == -1)
+	{
+		fprintf(stderr, "ERROR: %s holds blocks, which need a seekable input and output.\n", filename);
+		return false;
+	}
+
+	// Index gives where every segment starts in both files
+	Arena* arena = createArena(ARENA_BLOCK_SIZE);
+	BlockIndex* index = readBlockIndex(arena, fp, firstOffset);
+	if(index == NULL)
 	{
-		return;
+		fprintf(stderr, "ERROR: %s has an invalid block index.\n", filename);
+		freeArena(arena);
+		return false;
 	}
-	space += 20; 
-	printTree(node -> rightChild, space); 
-	printf("\n");
+
+	// Segments are written in place, straight to the descriptor and through the page cache, once
+	// what is buffered before them is written
+	bool success = flushOutput(decompressed);
+
+	// Every slot holds one segment being decoded, with room for two per thread
+	int slotCount = threadCount * 2;
+	DecodeJob* jobs = arenaAlloc(arena, sizeof(*jobs) * slotCount);
 	int i;
-	for (i = 20; i < space; i++)
+	for(i = 0; i < slotCount; i++)
+	{
+		jobs[i].arena = createArena(ARENA_BLOCK_SIZE);
+		jobs[i].table = table;
+		jobs[i].input = fileno(fp);
+		jobs[i].output = decompressed -> fd;
+		jobs[i].filename = filename;
+	}
+	ThreadPool* pool = createThreadPool(threadCount);
+
+	// Fill every slot, then refill each slot as its segment finishes, stopping at the first error
+	uint32_t segment;
+	for(segment = 0; segment < index -> blockCount && segment < (uint32_t)slotCount && success; segment++)
+	{
+		submitSegment(pool, &jobs[segment], &index -> blocks[segment], segment);
+	}
+	for(segment = 0; segment < index -> blockCount && success; segment++)
+	{
+		DecodeJob* job = &jobs[segment % slotCount];
+		waitForTask(pool, &job -> done);
+		success = job -> success;
+
+		if(success && segment + slotCount < index -> blockCount)
+		{
+			submitSegment(pool, job, &index -> blocks[segment + slotCount], segment + slotCount);
+		}
+	}
+
+	freeThreadPool(pool);
+	for(i = 0; i < slotCount; i++)
 	{
-		printf(" "); 
+		freeArena(jobs[i].arena);
 	}
-	printNode(node);
-	printTree(node -> leftChild, space); 
+	freeArena(arena);
+	return success;
 }
 
-void freeTreeHelper(Node* node)
+void submitSegment(ThreadPool* pool, DecodeJob* job, BlockEntry* block, uint32_t number)
 {
-	if(node -> leftChild != NULL)
+	job -> block = block;
+	job -> number = number;
+	job -> success = false;
+	resetArena(job -> arena);
+	submitTask(pool, decodeSegment, job, &job -> done);
+}
+
+void decodeSegment(void* argument)
+{
+	DecodeJob* job = argument;
+	BlockEntry* block = job -> block;
+	unsigned char* output = decodeBlock(job -> arena, job -> input, block, job -> table, job -> number, job -> filename);
+
+	// Write straight into the segment's place in the output
+	STATS_ADD(STATS_WRITE_CALLS, 1);
+	job -> success = output != NULL &&
+		pwrite(job -> output, output, block -> originalSize, block -> originalOffset) == (ssize_t)block -> originalSize;
+}
+
+bool writeRange(char* filename, uint64_t offset, uint64_t length, OutputFile* decompressed)
+{
+	SeekableFile* file = openSeekable(filename);
+	if(file == NULL)
 	{
-		freeTreeHelper(node -> leftChild);
+		return false;
 	}
-	if(node -> rightChild != NULL)
+
+	// Copy the range out a buffer at a time
+	unsigned char* output = arenaAlloc(file -> arena, BIT_BUFFER_SIZE);
+	bool success = true;
+	while(length > 0 && success)
 	{
-		freeTreeHelper(node -> rightChild);
+		size_t copied = 0;
+		success = readRange(file, offset, length < BIT_BUFFER_SIZE ? length : BIT_BUFFER_SIZE, output, &copied);
+		writeOutput(decompressed, output, copied);
+		if(copied == 0)
+		{
+			break;
+		}
+		offset += copied;
+		length -= copied;
 	}
-	free(node);
+
+	closeSeekable(file);
+	return success;
 }